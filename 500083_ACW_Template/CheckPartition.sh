@@ -0,0 +1,81 @@
+#!/bin/sh
+# Linux only check of the Partition command
+# builds the program in a temporary directory and runs a sample of FindShortestRoute queries in
+# process, then again with the network split into 2, 5 and 16 shards
+# every sharded route must have the same number of hops as the in process route, and is then
+# checked link by link with the Check command in a second, unpartitioned run
+#
+# usage: sh CheckPartition.sh [compiler]
+set -e
+
+COMPILER=${1:-g++}
+SOURCE_DIR=$(cd "$(dirname "$0")" && pwd)
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+cp "$SOURCE_DIR"/*.cpp "$SOURCE_DIR"/*.h "$SOURCE_DIR"/Places.csv "$SOURCE_DIR"/Links.csv "$WORK_DIR"
+cd "$WORK_DIR"
+# the sources include Utility.h, which only matches utility.h on a case insensitive file system
+[ -f Utility.h ] || cp utility.h Utility.h
+"$COMPILER" -std=c++14 -O2 -pthread *.cpp -o Navigation
+
+# Main reads its commands from commands.txt, a trailing newline would be run as an empty command
+run() {
+    printf '%s' "$1" > commands.txt
+    ./Navigation < /dev/null > /dev/null
+}
+
+# every 9th place to every 13th place, in every mode
+QUERIES=$(for mode in Foot Bike Car Bus Rail Ship; do
+    for start in $(awk -F, 'NR % 9 == 1 { print $2 }' Places.csv); do
+        for end in $(awk -F, 'NR % 13 == 1 { print $2 }' Places.csv); do
+            echo "FindShortestRoute $mode $start $end"
+        done
+    done
+done)
+
+run "$QUERIES
+Partition 2
+$QUERIES
+Partition 5
+$QUERIES
+Partition 16
+$QUERIES
+Partition 1"
+
+# the first answer to each query is in process, the later ones are sharded
+# sharded routes are written out as Check commands for the second run
+awk -v checks=checks.txt '
+    /^ERROR/ { print "error: " $0; failed = 1 }
+    /^FindShortestRoute / { query = $0; mode = $2; answer = seen[query]++; route = ""; hops = -1; inRoute = 1; next }
+    inRoute && /^$/ {
+        inRoute = 0
+        if (answer == 0) {
+            expected[query] = hops
+            next
+        }
+        ++compared
+        if (hops != expected[query]) {
+            print "mismatch: " query " has " hops " hops sharded, " expected[query] " in process"
+            failed = 1
+        }
+        if (hops > 0) {
+            print "Check " mode route > checks
+        }
+        next
+    }
+    inRoute && /^FAIL$/ { next }
+    inRoute { route = route " " $0; ++hops }
+    END {
+        print compared " sharded routes compared"
+        exit failed
+    }
+' Output.txt
+
+run "$(cat checks.txt)"
+if grep -q ',FAIL$' Output.txt; then
+    grep ',FAIL$' Output.txt | sed 's/^/invalid link: /'
+    exit 1
+fi
+
+echo "Partition check passed"
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "Landmarks.h"
+
+// method to fill dist with the hop count from the source to every node, UNREACHABLE if there is no route
+static void HopDistances(const ModeGraph& graph, int source, std::vector<std::uint16_t>& dist) {
+    dist.assign(graph.GetNodeCount(), static_cast<std::uint16_t>(Landmarks::UNREACHABLE));
+
+    std::vector<int> queue;
+    queue.reserve(graph.GetNodeCount());
+    queue.push_back(source);
+    dist[source] = 0;
+
+    for (size_t head = 0; head < queue.size(); ++head) {
+        const int current = queue[head];
+        const std::uint16_t nextDist = static_cast<std::uint16_t>(dist[current] + 1);
+        for (const int* it = graph.NeighboursBegin(current); it != graph.NeighboursEnd(current); ++it) {
+            if (dist[*it] == Landmarks::UNREACHABLE) {
+                dist[*it] = nextDist;
+                queue.push_back(*it);
+            }
+        }
+    }
+}
+
+// method to pick the landmarks by farthest point selection
+// the seeds are used first if they have any arcs in this mode, each following landmark
+// is the node with the largest hop distance to its nearest landmark so far
+// nodes that no landmark reaches yet count as farthest so every component gets covered
+void Landmarks::Build(const ModeGraph& graph, int seedA, int seedB) {
+    const int nodeCount = graph.GetNodeCount();
+
+    m_count = 0;
+    m_landmarks.clear();
+    m_distances.clear();
+    m_built = true;
+
+    // only nodes with arcs in this mode can be landmarks
+    std::vector<int> candidates;
+    for (int node = 0; node < nodeCount; ++node) {
+        if (graph.GetDegree(node) > 0) {
+            candidates.push_back(node);
+        }
+    }
+
+    if (candidates.empty()) {
+        return;
+    }
+
+    std::vector<int> seeds;
+    for (const int seed : { seedA, seedB }) {
+        if (seed >= 0 && seed < nodeCount && graph.GetDegree(seed) > 0
+            && std::find(seeds.begin(), seeds.end(), seed) == seeds.end()) {
+            seeds.push_back(seed);
+        }
+    }
+
+    std::vector<std::vector<std::uint16_t>> rows;
+    std::vector<int> nearest(nodeCount, std::numeric_limits<int>::max());
+    std::vector<std::uint16_t> dist;
+
+    // without a usable seed, start from the node farthest away from any candidate
+    int next = seeds.empty() ? -1 : seeds[0];
+    if (next < 0) {
+        HopDistances(graph, candidates[0], dist);
+        next = candidates[0];
+        for (const int node : candidates) {
+            if (dist[node] != UNREACHABLE && dist[node] > dist[next]) {
+                next = node;
+            }
+        }
+    }
+
+    while (next >= 0 && static_cast<int>(m_landmarks.size()) < MAX_LANDMARKS) {
+        m_landmarks.push_back(next);
+        HopDistances(graph, next, dist);
+        rows.push_back(dist);
+
+        for (const int node : candidates) {
+            if (dist[node] != UNREACHABLE && dist[node] < nearest[node]) {
+                nearest[node] = dist[node];
+            }
+        }
+
+        // second seed goes next, after that the farthest candidate
+        next = -1;
+        if (m_landmarks.size() < seeds.size()) {
+            next = seeds[m_landmarks.size()];
+        }
+        else {
+            int farthest = 0;
+            for (const int node : candidates) {
+                if (nearest[node] > farthest) {
+                    farthest = nearest[node];
+                    next = node;
+                }
+            }
+        }
+    }
+
+    // transpose into node major order so a query reads one contiguous row per node
+    m_count = static_cast<int>(m_landmarks.size());
+    m_distances.resize(static_cast<size_t>(nodeCount) * m_count);
+    for (int node = 0; node < nodeCount; ++node) {
+        for (int i = 0; i < m_count; ++i) {
+            m_distances[static_cast<size_t>(node) * m_count + i] = rows[i][node];
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "ModeGraph.h"
+
+// landmarks class
+// stores hop distances from a small set of landmark nodes to every node of one mode graph (ALT preprocessing)
+// by the triangle inequality |d(L,t) - d(L,v)| <= d(v,t) for every landmark L,
+// so the tables give an admissible and consistent A* heuristic for shortest route queries
+class Landmarks final {
+public:
+    static constexpr int MAX_LANDMARKS = 8;
+    static constexpr std::uint16_t UNREACHABLE = 0xFFFF;
+
+    Landmarks() : m_count(0), m_landmarks(), m_distances(), m_built(false) {}
+
+    // method to pick the landmarks and fill the distance table
+    // seedA and seedB are tried as the first two landmarks (e.g. the MaxDist pair), pass -1 to skip
+    void Build(const ModeGraph& graph, int seedA, int seedB);
+
+    // method to get the row of landmark distances for a node
+    inline const std::uint16_t* GetRow(int node) const {
+        return m_distances.data() + static_cast<size_t>(node) * m_count;
+    }
+
+    // method to get a lower bound on the hops from a node to the target row
+    // returns -1 if the landmarks prove the target cannot be reached from the node
+    inline int LowerBound(int node, const std::uint16_t* targetRow) const {
+        const std::uint16_t* const nodeRow = GetRow(node);
+        int bound = 0;
+        for (int i = 0; i < m_count; ++i) {
+            const bool nodeReached = nodeRow[i] != UNREACHABLE;
+            const bool targetReached = targetRow[i] != UNREACHABLE;
+            if (nodeReached != targetReached) {
+                return -1;
+            }
+            if (nodeReached) {
+                const int difference = std::abs(static_cast<int>(targetRow[i]) - static_cast<int>(nodeRow[i]));
+                if (difference > bound) {
+                    bound = difference;
+                }
+            }
+        }
+        return bound;
+    }
+
+    // getters
+    bool IsBuilt() const { return m_built; }
+    int GetCount() const { return m_count; }
+    size_t GetMemoryBytes() const {
+        return m_distances.capacity() * sizeof(std::uint16_t) + m_landmarks.capacity() * sizeof(int);
+    }
+
+private:
+    int m_count;
+    std::vector<int> m_landmarks;
+    // node major, m_distances[node * m_count + landmark]
+    std::vector<std::uint16_t> m_distances;
+    bool m_built;
+};
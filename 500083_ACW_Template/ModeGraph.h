@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+
+// mode graph struct
+// compact adjacency (offsets + targets) of the arcs that are valid for a single transport mode
+// nodes are referred to by their index in the navigation node list rather than by pointer,
+// so searches can use flat vectors instead of hash maps
+struct ModeGraph {
+    std::vector<int> offsets;
+    std::vector<int> targets;
+
+    // number of nodes in the graph
+    inline int GetNodeCount() const {
+        return offsets.empty() ? 0 : static_cast<int>(offsets.size()) - 1;
+    }
+
+    // number of valid arcs leaving a node
+    inline int GetDegree(int node) const {
+        return offsets[node + 1] - offsets[node];
+    }
+
+    // pointers to the first and one past the last neighbour of a node
+    inline const int* NeighboursBegin(int node) const { return targets.data() + offsets[node]; }
+    inline const int* NeighboursEnd(int node) const { return targets.data() + offsets[node + 1]; }
+};
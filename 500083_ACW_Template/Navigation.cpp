@@ -7,22 +7,38 @@
 #include <unordered_set>
 #include <vector>
 #include <queue>
+#include <algorithm>
+#include <chrono>
+#include <tuple>
+#include <functional>
 
 #include "Navigation.h"
 #include "Utility.h"
+#include "Partitioner.h"
+
+// output buffers, two buffers make the writer double buffered
+constexpr size_t OUTPUT_BUFFER_BYTES = 1024 * 1024;
+constexpr int OUTPUT_BUFFER_COUNT = 2;
 
 // constructor to initialise the output file
 Navigation::Navigation()
-    : m_outFile("Output.txt")
+    : m_outWriter(OUTPUT_BUFFER_BYTES, OUTPUT_BUFFER_COUNT),
+    m_outFile(&m_outWriter),
+    m_landmarkSeedA(-1),
+    m_landmarkSeedB(-1),
+    m_searchStamp(0)
 {
+    m_outWriter.Open(OutputWriter::Destination::File, "Output.txt");
 }
 
 // destructor to delete all nodes in the map
+// the output writer flushes everything still buffered when it is destroyed after this
 Navigation::~Navigation() {
     for (const auto& pair : m_nodes) {
         delete pair.second;
     }
     m_nodes.clear();
+    m_nodeList.clear();
 }
 
 // method to process the command string
@@ -72,6 +88,20 @@ bool Navigation::ProcessCommand(const std::string& commandString) {
         inString >> modeStr >> startRef >> endRef;
         FindShortestRoute(modeStr, startRef, endRef);
     }
+    else if (command.compare("LandmarkStats") == 0) {
+        LandmarkStats();
+    }
+    else if (command.compare("Partition") == 0) {
+        int shardCount = 0;
+        inString >> shardCount;
+        Partition(shardCount);
+    }
+    else if (command.compare("Output") == 0) {
+        std::string destinationStr;
+        std::string target;
+        inString >> destinationStr >> target;
+        SetOutput(destinationStr, target);
+    }
     else {
         return false;
     }
@@ -109,7 +139,9 @@ bool Navigation::BuildNetwork(const std::string& fileNamePlaces, const std::stri
         // convert latitude and longitude to UTM coordinates
         double x, y;
         Utility::LLtoUTM(latitude, longitude, x, y);
-        m_nodes[reference] = new Node(reference, name, x, y);
+        Node* const node = new Node(reference, name, x, y, static_cast<int>(m_nodeList.size()));
+        m_nodes[reference] = node;
+        m_nodeList.push_back(node);
     }
 
     // links file
@@ -186,9 +218,77 @@ bool Navigation::BuildNetwork(const std::string& fileNamePlaces, const std::stri
     m_maxLinkStream << maxLinkStartRef << "," << maxLinkEndRef << "," << std::fixed << std::setprecision(3) << sqrt(maxLinkDistance) << "\n";
     m_maxLinkStream << "\n";
 
+    BuildModeGraphs();
+    BuildRouteTables();
+
+    // ALT preprocessing for the modes that still need a search, a mode with a route table never uses
+    // its landmarks, the MaxDist pair seeds the landmarks as they sit on the edge of the network
+    m_landmarkSeedA = maxDistStartNode != nullptr ? maxDistStartNode->GetIndex() : -1;
+    m_landmarkSeedB = maxDistEndNode != nullptr ? maxDistEndNode->GetIndex() : -1;
+    for (int mode = 0; mode < TRANSPORT_MODE_COUNT; ++mode) {
+        if (!m_routeTables[mode].IsBuilt()) {
+            m_landmarks[mode].Build(m_modeGraphs[mode], m_landmarkSeedA, m_landmarkSeedB);
+        }
+    }
+
     return true;
 }
 
+// method to build the all pairs route tables for as many modes as the memory budget allows
+// the smallest tables are built first, as they answer the most queries per byte
+// modes without a table keep using the landmark search
+void Navigation::BuildRouteTables() {
+    constexpr size_t ROUTE_TABLE_BUDGET_BYTES = 64 * 1024 * 1024;
+
+    std::vector<std::pair<size_t, int>> estimates;
+    for (int mode = 0; mode < TRANSPORT_MODE_COUNT; ++mode) {
+        m_routeTables[mode].Clear();
+        estimates.emplace_back(RouteTable::EstimateBytes(m_modeGraphs[mode]), mode);
+    }
+    std::sort(estimates.begin(), estimates.end());
+
+    size_t remaining = ROUTE_TABLE_BUDGET_BYTES;
+    for (const auto& estimate : estimates) {
+        if (estimate.first > remaining) {
+            break;
+        }
+        RouteTable& table = m_routeTables[estimate.second];
+        if (table.Build(m_modeGraphs[estimate.second])) {
+            remaining -= std::min(remaining, table.GetMemoryBytes());
+        }
+    }
+}
+
+// method to build a compact graph per transport mode
+// each graph only holds the arcs that IsValidMode allows for that mode,
+// so searches never have to filter arcs or hash node pointers
+void Navigation::BuildModeGraphs() {
+    const int nodeCount = static_cast<int>(m_nodeList.size());
+
+    for (int modeIndex = 0; modeIndex < TRANSPORT_MODE_COUNT; ++modeIndex) {
+        const TransportMode mode = static_cast<TransportMode>(modeIndex);
+        ModeGraph& graph = m_modeGraphs[modeIndex];
+        graph.offsets.assign(1, 0);
+        graph.offsets.reserve(nodeCount + 1);
+        graph.targets.clear();
+
+        for (const Node* const node : m_nodeList) {
+            for (const auto& pair : node->GetNeighbours()) {
+                if (IsValidMode(mode, pair.second.mode)) {
+                    graph.targets.push_back(pair.first->GetIndex());
+                }
+            }
+            graph.offsets.push_back(static_cast<int>(graph.targets.size()));
+        }
+        graph.targets.shrink_to_fit();
+    }
+
+    m_searchStamps.assign(nodeCount, 0);
+    m_searchCosts.assign(nodeCount, 0);
+    m_searchPrevious.assign(nodeCount, -1);
+    m_searchStamp = 0;
+}
+
 // method to output the stored output stream of maxdist
 void Navigation::FindMaxDist() {
     m_outFile << m_maxDistStream.str();
@@ -303,9 +403,9 @@ void Navigation::CheckRoute(const std::string& modeStr, const std::vector<int>&
     m_outFile << "\n";
 }
 
-// method to find a route between two nodes using DFS
+// method to find a route between two nodes
 // it takes the mode and the references of the start and end nodes
-// it then uses a queue to store nodes and iterates through them to find a valid route
+// modes with a route table answer from it without searching, the others use a BFS over the mode graph
 // if a valid route is found it outputs the references of the nodes
 // otherwise it outputs FAIL
 void Navigation::FindRoute(const std::string& modeStr, int startRef, int endRef) {
@@ -313,124 +413,351 @@ void Navigation::FindRoute(const std::string& modeStr, int startRef, int endRef)
 
     const TransportMode mode = StringToTransportMode(modeStr);
 
+    // after a Partition command the shard workers answer instead
+    if (m_shards.IsRunning()) {
+        std::vector<int> route;
+        m_shards.FindShortestRoute(static_cast<int>(mode), startRef, endRef, route);
+        if (m_shards.IsRunning()) {
+            WriteRoute(route);
+            return;
+        }
+        // a worker failed and the coordinator stopped them all, so the query is answered here instead
+        m_outFile << "ERROR: Shard workers failed, partition stopped" << "\n";
+    }
+
     // find the start and end nodes based on their references
     const auto startIter = m_nodes.find(startRef);
     const auto endIter = m_nodes.find(endRef);
 
-    if (startIter != m_nodes.end() && endIter != m_nodes.end()) {
-        const Node* const startNode = startIter->second;
-        const Node* const endNode = endIter->second;
+    // the fewest hops route is as good as any, from the route table when this mode has one
+    // so the output does not depend on which tables the memory budget allowed
+    const RouteTable& table = m_routeTables[static_cast<int>(mode)];
+    std::vector<int> route;
+    int settled = 0;
+    if (startIter != m_nodes.end() && endIter != m_nodes.end()
+        && (table.IsBuilt()
+            ? table.FindRoute(startIter->second->GetIndex(), endIter->second->GetIndex(), route)
+            : BreadthFirstSearch(mode, startIter->second->GetIndex(), endIter->second->GetIndex(), route, settled))) {
+        // convert node indices to references
+        for (int& node : route) {
+            node = m_nodeList[node]->GetReference();
+        }
+    }
 
-        std::unordered_set<const Node*> visited;
-        std::vector<int> route;
-        std::queue<const Node*> queue;
+    // start or end node not found, or no valid route leaves the route empty
+    WriteRoute(route);
+}
 
-        queue.push(startNode);
-        visited.insert(startNode);
+// method to find the shortest route between two nodes from the route table,
+// or using A* with ALT landmark bounds for modes without a table
+// the shortest route is the one with the fewest nodes, so every arc costs one hop
+// if a valid route is found it outputs the references of the nodes
+// otherwise it outputs FAIL
+void Navigation::FindShortestRoute(const std::string& modeStr, int startRef, int endRef) {
+    m_outFile << "FindShortestRoute " << modeStr << " " << startRef << " " << endRef << "\n";
 
-        while (!queue.empty()) {
-            const Node* const currentNode = queue.front();
-            queue.pop();
+    const TransportMode mode = StringToTransportMode(modeStr);
 
-            route.push_back(currentNode->GetReference());
+    std::vector<int> route;
 
-            if (currentNode == endNode) {
-                // Found a valid route
-                for (const int ref : route) {
-                    m_outFile << ref << "\n";
-                }
-                m_outFile << "\n";
-                return;
-            }
+    // after a Partition command the shard workers answer instead
+    if (m_shards.IsRunning()) {
+        m_shards.FindShortestRoute(static_cast<int>(mode), startRef, endRef, route);
+        if (m_shards.IsRunning()) {
+            WriteRoute(route);
+            return;
+        }
+        // a worker failed and the coordinator stopped them all, so the query is answered here instead
+        m_outFile << "ERROR: Shard workers failed, partition stopped" << "\n";
+        route.clear();
+    }
 
-            for (const auto& pair : currentNode->GetNeighbours()) {
-                const Node* const neighbour = pair.first;
-                const TransportMode arcMode = pair.second.mode;
+    // find the start and end nodes based on their references
+    const auto startIter = m_nodes.find(startRef);
+    const auto endIter = m_nodes.find(endRef);
 
-                if (visited.count(neighbour) == 0 && IsValidMode(mode, arcMode)) {
-                    queue.push(neighbour);
-                    visited.insert(neighbour);
-                }
-            }
+    // the route table answers without a search when one was built for this mode
+    const RouteTable& table = m_routeTables[static_cast<int>(mode)];
+    int settled = 0;
+    if (startIter != m_nodes.end() && endIter != m_nodes.end()
+        && (table.IsBuilt()
+            ? table.FindRoute(startIter->second->GetIndex(), endIter->second->GetIndex(), route)
+            : LandmarkSearch(mode, startIter->second->GetIndex(), endIter->second->GetIndex(), route, settled))) {
+        // convert node indices to references
+        for (int& node : route) {
+            node = m_nodeList[node]->GetReference();
         }
+    }
+
+    // start or end node not found, or no valid route leaves the route empty
+    WriteRoute(route);
+}
 
-        // No valid route found
+// method to output a route as one reference per line followed by a blank line
+// an empty route is output as FAIL
+void Navigation::WriteRoute(const std::vector<int>& refs) {
+    if (refs.empty()) {
         m_outFile << "FAIL" << "\n";
-        m_outFile << "\n";
     }
-    else {
-        m_outFile << "FAIL" << "\n";
-        m_outFile << "\n";
+    for (const int ref : refs) {
+        m_outFile << ref << "\n";
     }
+    m_outFile << "\n";
 }
 
-// method to find the shortest route between two nodes using BFS
-// utilises a queue to store nodes 
-// it then iterates through the nodes to find the shortest route
-// if a valid route is found it outputs the references of the nodes
-// otherwise it outputs FAIL
-void Navigation::FindShortestRoute(const std::string& modeStr, int startRef, int endRef) {
-    m_outFile << "FindShortestRoute " << modeStr << " " << startRef << " " << endRef << "\n";
+// method to send all further output to another destination
+// the destination is File <name>, Stdout, Socket <host:port> or Mapped <name> for a memory mapped file
+// the command is output to the new destination, or with an error to the old one if it could not be opened
+void Navigation::SetOutput(const std::string& destinationStr, const std::string& target) {
+    OutputWriter::Destination destination = OutputWriter::Destination::File;
+    // flushing first tells a failed write to the old destination apart from a failed open of the new one
+    const bool flushed = m_outWriter.Flush();
+    const bool opened = StringToDestination(destinationStr, destination) && m_outWriter.Open(destination, target);
+
+    m_outFile << "Output " << destinationStr;
+    if (!target.empty()) {
+        m_outFile << " " << target;
+    }
+    m_outFile << "\n";
 
-    const TransportMode mode = StringToTransportMode(modeStr);
+    if (!flushed) {
+        m_outFile << "ERROR: Output to the previous destination was lost" << "\n";
+    }
+    else if (!opened) {
+        m_outFile << "ERROR: Could not open output" << "\n";
+    }
 
-    // find the start and end nodes based on their references
-    const auto startIter = m_nodes.find(startRef);
-    const auto endIter = m_nodes.find(endRef);
+    m_outFile << "\n";
+}
 
-    if (startIter != m_nodes.end() && endIter != m_nodes.end()) {
-        const Node* const startNode = startIter->second;
-        const Node* const endNode = endIter->second;
+// method to split the network into geographic shards served by worker processes
+// it writes the shard files, starts one worker per shard and outputs the places and
+// boundary places of each shard followed by the number of links cut between shards
+// FindRoute and FindShortestRoute then use the workers until Partition is given a count of 1 or less
+// the count is limited to MAX_SHARDS and to the number of places, so no shard is empty
+void Navigation::Partition(int shardCount) {
+    constexpr int MAX_SHARDS = 16;
 
-        std::unordered_map<const Node*, const Node*> previous;
-        std::unordered_set<const Node*> visited;
-        std::queue<const Node*> queue;
+    m_outFile << "Partition " << shardCount << "\n";
 
-        visited.insert(startNode);
-        queue.push(startNode);
+    m_shards.Stop();
 
-        while (!queue.empty()) {
-            const Node* const currentNode = queue.front();
-            queue.pop();
+    shardCount = std::min(shardCount, std::min(MAX_SHARDS, static_cast<int>(m_nodeList.size())));
 
-            if (currentNode == endNode) {
-                // reached the end node, construct the shortest route
-                std::vector<int> route;
-                const Node* node = endNode;
-                while (node != nullptr) {
-                    route.push_back(node->GetReference());
-                    node = previous[node];
+    if (shardCount > 1 && !ShardCoordinator::IsSupported()) {
+        m_outFile << "ERROR: Shard workers are not supported on this system" << "\n";
+    }
+    else if (shardCount > 1) {
+        // bit n of arcMasks[mode] is set if arcs of mode n are valid for mode
+        unsigned int arcMasks[TRANSPORT_MODE_COUNT];
+        for (int mode = 0; mode < TRANSPORT_MODE_COUNT; ++mode) {
+            arcMasks[mode] = 0;
+            for (int arcMode = 0; arcMode < TRANSPORT_MODE_COUNT; ++arcMode) {
+                if (IsValidMode(static_cast<TransportMode>(mode), static_cast<TransportMode>(arcMode))) {
+                    arcMasks[mode] |= 1u << arcMode;
                 }
-                std::reverse(route.begin(), route.end());
+            }
+        }
 
-                // output the shortest route
-                for (const int ref : route) {
-                    m_outFile << ref << "\n";
-                }
-                m_outFile << "\n";
-                return;
+        // the shard files go in a temporary directory that m_shards removes again when stopped
+        const std::string prefix = m_shards.CreateWorkDirectory();
+        const std::vector<int> shardOf = Partitioner::SplitGeographic(m_nodeList, shardCount);
+
+        if (prefix.empty() || !Partitioner::WriteShards(m_nodeList, shardOf, shardCount, prefix)) {
+            m_shards.Stop();
+            m_outFile << "ERROR: Could not write shard files" << "\n";
+        }
+        else if (!m_shards.Start(prefix, shardCount, arcMasks, TRANSPORT_MODE_COUNT)) {
+            m_outFile << "ERROR: Could not start shard workers" << "\n";
+        }
+        else {
+            for (int shard = 0; shard < m_shards.GetShardCount(); ++shard) {
+                m_outFile << shard << "," << m_shards.GetShardNodeCount(shard) << ","
+                    << m_shards.GetShardBoundaryCount(shard) << "\n";
             }
+            m_outFile << "Cut," << m_shards.GetCutLinkCount() << "\n";
+        }
+    }
 
-            for (const auto& pair : currentNode->GetNeighbours()) {
-                const TransportMode arcMode = pair.second.mode;
-                if (IsValidMode(mode, arcMode)) {
-                    const Node* const neighbour = pair.first;
-                    if (visited.count(neighbour) == 0) {
-                        visited.insert(neighbour);
-                        previous[neighbour] = currentNode;
-                        queue.push(neighbour);
-                    }
-                }
+    m_outFile << "\n";
+}
+
+// method to start a new search, invalidating all scratch entries of the previous one
+void Navigation::NextSearchStamp() {
+    ++m_searchStamp;
+    if (m_searchStamp == 0) {
+        std::fill(m_searchStamps.begin(), m_searchStamps.end(), 0);
+        m_searchStamp = 1;
+    }
+}
+
+// method to find the route with the fewest hops using a plain BFS over the mode graph
+// route is filled with node indices from start to end, settled counts the nodes taken off the queue
+bool Navigation::BreadthFirstSearch(TransportMode mode, int start, int end, std::vector<int>& route, int& settled) {
+    const ModeGraph& graph = m_modeGraphs[static_cast<int>(mode)];
+    route.clear();
+    settled = 0;
+
+    NextSearchStamp();
+    std::queue<int> queue;
+    m_searchStamps[start] = m_searchStamp;
+    m_searchPrevious[start] = -1;
+    queue.push(start);
+
+    while (!queue.empty()) {
+        const int current = queue.front();
+        queue.pop();
+        ++settled;
+
+        if (current == end) {
+            for (int node = end; node != -1; node = m_searchPrevious[node]) {
+                route.push_back(node);
             }
+            std::reverse(route.begin(), route.end());
+            return true;
         }
 
-        // no valid route found
-        m_outFile << "FAIL" << "\n";
-        m_outFile << "\n";
+        for (const int* it = graph.NeighboursBegin(current); it != graph.NeighboursEnd(current); ++it) {
+            if (m_searchStamps[*it] != m_searchStamp) {
+                m_searchStamps[*it] = m_searchStamp;
+                m_searchPrevious[*it] = current;
+                queue.push(*it);
+            }
+        }
     }
-    else {
-        // start or end node not found
-        m_outFile << "FAIL" << "\n";
+
+    return false;
+}
+
+// method to find the route with the fewest hops using A* guided by the landmark lower bounds
+// nodes the landmarks prove cannot reach the end are never queued
+// route is filled with node indices from start to end, settled counts the nodes expanded
+bool Navigation::LandmarkSearch(TransportMode mode, int start, int end, std::vector<int>& route, int& settled) {
+    const ModeGraph& graph = m_modeGraphs[static_cast<int>(mode)];
+    const Landmarks& landmarks = m_landmarks[static_cast<int>(mode)];
+    const std::uint16_t* const targetRow = landmarks.GetRow(end);
+    route.clear();
+    settled = 0;
+
+    const int startBound = landmarks.LowerBound(start, targetRow);
+    if (startBound < 0) {
+        return false;
+    }
+
+    // open list ordered by estimated total hops, ties go to the node furthest from the start
+    using OpenEntry = std::tuple<int, int, int>;
+    std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> open;
+
+    NextSearchStamp();
+    m_searchStamps[start] = m_searchStamp;
+    m_searchCosts[start] = 0;
+    m_searchPrevious[start] = -1;
+    open.emplace(startBound, 0, start);
+
+    while (!open.empty()) {
+        const int cost = -std::get<1>(open.top());
+        const int current = std::get<2>(open.top());
+        open.pop();
+
+        // skip stale entries that were improved after being queued
+        if (cost > m_searchCosts[current]) {
+            continue;
+        }
+        ++settled;
+
+        if (current == end) {
+            for (int node = end; node != -1; node = m_searchPrevious[node]) {
+                route.push_back(node);
+            }
+            std::reverse(route.begin(), route.end());
+            return true;
+        }
+
+        const int nextCost = cost + 1;
+        for (const int* it = graph.NeighboursBegin(current); it != graph.NeighboursEnd(current); ++it) {
+            const int neighbour = *it;
+            if (m_searchStamps[neighbour] == m_searchStamp && m_searchCosts[neighbour] <= nextCost) {
+                continue;
+            }
+
+            m_searchStamps[neighbour] = m_searchStamp;
+            m_searchCosts[neighbour] = nextCost;
+            m_searchPrevious[neighbour] = current;
+
+            const int bound = landmarks.LowerBound(neighbour, targetRow);
+            if (bound >= 0) {
+                open.emplace(nextCost + bound, -nextCost, neighbour);
+            }
+        }
+    }
+
+    return false;
+}
+
+// method to report the landmark preprocessing per transport mode
+// for each mode it outputs the landmark count and table memory, then runs the same sample of
+// shortest route queries with plain BFS and with ALT and outputs the average nodes settled and time
+// landmarks skipped at build time because the mode has a route table are built here first
+void Navigation::LandmarkStats() {
+    using std::chrono::high_resolution_clock;
+    using std::chrono::duration;
+
+    constexpr int SAMPLE_QUERIES = 64;
+
+    m_outFile << "LandmarkStats" << "\n";
+
+    for (int modeIndex = 0; modeIndex < TRANSPORT_MODE_COUNT; ++modeIndex) {
+        const TransportMode mode = static_cast<TransportMode>(modeIndex);
+        const ModeGraph& graph = m_modeGraphs[modeIndex];
+        Landmarks& landmarks = m_landmarks[modeIndex];
+        if (!landmarks.IsBuilt()) {
+            landmarks.Build(graph, m_landmarkSeedA, m_landmarkSeedB);
+        }
+
+        m_outFile << TransportModeToString(mode) << "," << landmarks.GetCount() << " landmarks,"
+            << landmarks.GetMemoryBytes() << " bytes";
+
+        // sample pairs are spread over the nodes that have arcs in this mode
+        std::vector<int> candidates;
+        for (int node = 0; node < graph.GetNodeCount(); ++node) {
+            if (graph.GetDegree(node) > 0) {
+                candidates.push_back(node);
+            }
+        }
+
+        if (!candidates.empty()) {
+            const size_t count = candidates.size();
+            std::vector<int> route;
+            long long bfsSettled = 0;
+            long long altSettled = 0;
+            double bfsMicroseconds = 0.0;
+            double altMicroseconds = 0.0;
+
+            for (int i = 0; i < SAMPLE_QUERIES; ++i) {
+                const int start = candidates[(static_cast<size_t>(i) * 7919) % count];
+                const int end = candidates[(static_cast<size_t>(i) * 104729 + count / 2) % count];
+                int settled = 0;
+
+                const auto bfsStart = high_resolution_clock::now();
+                BreadthFirstSearch(mode, start, end, route, settled);
+                bfsMicroseconds += duration<double, std::micro>(high_resolution_clock::now() - bfsStart).count();
+                bfsSettled += settled;
+
+                const auto altStart = high_resolution_clock::now();
+                LandmarkSearch(mode, start, end, route, settled);
+                altMicroseconds += duration<double, std::micro>(high_resolution_clock::now() - altStart).count();
+                altSettled += settled;
+            }
+
+            m_outFile << std::fixed << std::setprecision(3)
+                << ",BFS " << static_cast<double>(bfsSettled) / SAMPLE_QUERIES << " nodes "
+                << bfsMicroseconds / SAMPLE_QUERIES << " us"
+                << ",ALT " << static_cast<double>(altSettled) / SAMPLE_QUERIES << " nodes "
+                << altMicroseconds / SAMPLE_QUERIES << " us";
+        }
+
         m_outFile << "\n";
     }
-}
\ No newline at end of file
+
+    m_outFile << "\n";
+}
@@ -1,11 +1,19 @@
 #pragma once
 
 #include <fstream>
+#include <ostream>
 #include <string>
 #include <unordered_map>
 #include <cmath>
 #include <unordered_set>
 #include <sstream>
+#include <vector>
+
+#include "ModeGraph.h"
+#include "Landmarks.h"
+#include "RouteTable.h"
+#include "ShardCoordinator.h"
+#include "OutputWriter.h"
     
 
 // PARASOFT WILL GIVE WARNINGS WITH THIS FILE, IGNORE IT
@@ -15,6 +23,7 @@
 
 // Transport mode enum class, I have explicitly set the values for readability sake, but it is not necessary
 enum class TransportMode { Foot = 0, Bike = 1, Car = 2, Bus = 3, Rail = 4, Ship = 5 };
+constexpr int TRANSPORT_MODE_COUNT = 6;
 
 class Node;
 
@@ -57,15 +66,17 @@ private:
     const double m_x;
     const double m_y;
     const int m_reference;
+    const int m_index;
 
 public:
 	// constructor
-    Node(int ref, const std::string& name, double x, double y)
+    Node(int ref, const std::string& name, double x, double y, int index)
         : m_neighbours(),
         m_name(name),
         m_x(x),
         m_y(y),
-        m_reference(ref) {}
+        m_reference(ref),
+        m_index(index) {}
 
 	// destructor
     Node(const Node&) = delete;
@@ -78,6 +89,7 @@ public:
 
     // getters
     int GetReference() const { return m_reference; }
+    int GetIndex() const { return m_index; }
     double GetX() const { return m_x; }
     double GetY() const { return m_y; }
 
@@ -92,11 +104,33 @@ public:
 class Navigation final {
 private:
 	// member variables
-    std::ofstream m_outFile;
+    // all output goes through m_outFile into the buffers of m_outWriter, which writes them on its own thread
+    OutputWriter m_outWriter;
+    std::ostream m_outFile;
     std::unordered_map<int, Node*> m_nodes;
+    std::vector<const Node*> m_nodeList;
     std::ostringstream m_maxDistStream;
     std::ostringstream m_maxLinkStream;
 
+    // per mode graphs and ALT landmark tables, indexed by TransportMode
+    // landmarks are only built for the modes without a route table, seeded with the MaxDist pair
+    ModeGraph m_modeGraphs[TRANSPORT_MODE_COUNT];
+    Landmarks m_landmarks[TRANSPORT_MODE_COUNT];
+    int m_landmarkSeedA;
+    int m_landmarkSeedB;
+
+    // per mode all pairs route tables, only built for the modes that fit the memory budget
+    RouteTable m_routeTables[TRANSPORT_MODE_COUNT];
+
+    // search scratch space reused between queries, an entry is only valid when its stamp matches m_searchStamp
+    std::vector<unsigned int> m_searchStamps;
+    std::vector<int> m_searchCosts;
+    std::vector<int> m_searchPrevious;
+    unsigned int m_searchStamp;
+
+    // worker processes used for route queries after a Partition command
+    ShardCoordinator m_shards;
+
 public:
 	// constructor and destructor
     Navigation();
@@ -112,7 +146,9 @@ public:
 	// getters
     // ignore parasoft warnings
     const std::unordered_map<int, Node*>& GetNodes() const { return m_nodes; }
-    const std::ofstream& GetOutFile() const { return m_outFile; }
+    // the output stream is a std::ostream over m_outWriter rather than a std::ofstream,
+    // so callers can no longer use std::ofstream members such as is_open() through this getter
+    const std::ostream& GetOutFile() const { return m_outFile; }
 	// ignore parasoft warnings
 
 private:
@@ -135,6 +171,39 @@ private:
             return TransportMode::Foot;
     }
 
+	// method to convert transport mode enum value back to its links csv string
+    inline const char* TransportModeToString(TransportMode mode) const {
+        switch (mode) {
+        case TransportMode::Bike:
+            return "Bike";
+        case TransportMode::Car:
+            return "Car";
+        case TransportMode::Bus:
+            return "Bus";
+        case TransportMode::Rail:
+            return "Rail";
+        case TransportMode::Ship:
+            return "Ship";
+        default:
+            return "Foot";
+        }
+    }
+
+	// method to convert string from an Output command to an output destination
+    inline bool StringToDestination(const std::string& destinationStr, OutputWriter::Destination& destination) const {
+        if (destinationStr == "File")
+            destination = OutputWriter::Destination::File;
+        else if (destinationStr == "Stdout")
+            destination = OutputWriter::Destination::Stdout;
+        else if (destinationStr == "Socket")
+            destination = OutputWriter::Destination::Socket;
+        else if (destinationStr == "Mapped")
+            destination = OutputWriter::Destination::MappedFile;
+        else
+            return false;
+        return true;
+    }
+
 	// method to calculate squared distance between two nodes
 	// REMEMBER TO SQUARE ROOT THE RETURN VALUE
     inline double CalculateDistance(const Node* startNode, const Node* endNode) const {
@@ -170,6 +239,15 @@ private:
     void CheckRoute(const std::string& modeStr, const std::vector<int>& nodeRefs);
     void FindRoute(const std::string& modeStr, int startRef, int endRef);
     void FindShortestRoute(const std::string& modeStr, int startRef, int endRef);
+    void LandmarkStats();
+    void Partition(int shardCount);
+    void SetOutput(const std::string& destinationStr, const std::string& target);
+    void WriteRoute(const std::vector<int>& refs);
+    void BuildModeGraphs();
+    void BuildRouteTables();
+    void NextSearchStamp();
+    bool BreadthFirstSearch(TransportMode mode, int start, int end, std::vector<int>& route, int& settled);
+    bool LandmarkSearch(TransportMode mode, int start, int end, std::vector<int>& route, int& settled);
     bool FindRouteHelper(const Node* currentNode, const Node* endNode, TransportMode mode,
         std::unordered_set<const Node*>& visited, std::vector<int>& route);
 };
\ No newline at end of file
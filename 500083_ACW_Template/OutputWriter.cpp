@@ -0,0 +1,437 @@
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <cstdlib>
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include "OutputWriter.h"
+
+namespace {
+#ifndef _WIN32
+    // a closed socket must show up as a failed send rather than a SIGPIPE
+#ifdef MSG_NOSIGNAL
+    constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    constexpr int SEND_FLAGS = 0;
+#endif
+
+    // method to connect a TCP socket to host:port, returns -1 on failure
+    int ConnectSocket(const std::string& target) {
+        const size_t colon = target.rfind(':');
+        if (colon == std::string::npos) {
+            return -1;
+        }
+        const std::string host = target.substr(0, colon);
+        const std::string port = target.substr(colon + 1);
+
+        addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        addrinfo* addresses = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+            return -1;
+        }
+
+        int fd = -1;
+        for (const addrinfo* address = addresses; address != nullptr && fd < 0; address = address->ai_next) {
+            fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (fd >= 0 && fcntl(fd, F_SETFD, FD_CLOEXEC) == 0 && connect(fd, address->ai_addr, address->ai_addrlen) != 0) {
+                close(fd);
+                fd = -1;
+            }
+#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+            // where send has no MSG_NOSIGNAL the socket itself is told not to raise SIGPIPE
+            const int on = 1;
+            if (fd >= 0 && setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on)) != 0) {
+                close(fd);
+                fd = -1;
+            }
+#endif
+        }
+        freeaddrinfo(addresses);
+
+        return fd;
+    }
+#endif
+}
+
+// constructor to preallocate the buffers and start the writer thread
+// output is discarded until a destination is opened
+OutputWriter::OutputWriter(size_t bufferBytes, int bufferCount)
+    : m_bufferBytes(std::max<size_t>(bufferBytes, 1)),
+    m_buffers(std::max(bufferCount, 2), std::vector<char>(m_bufferBytes)),
+    m_used(m_buffers.size(), 0),
+    m_filled(),
+    m_free(),
+    m_current(0),
+    m_mutex(),
+    m_filledReady(),
+    m_bufferFreed(),
+    m_writing(false),
+    m_stopping(false),
+    m_failed(false),
+    m_thread(),
+    m_destination(Destination::File),
+    m_fd(-1),
+    m_ownsFd(false),
+    m_map(nullptr),
+    m_mapCapacity(0),
+    m_mapSize(0),
+    m_fileKey(),
+    m_openedFiles()
+{
+    for (int buffer = static_cast<int>(m_buffers.size()) - 1; buffer > 0; --buffer) {
+        m_free.push_back(buffer);
+    }
+    setp(m_buffers[m_current].data(), m_buffers[m_current].data() + m_bufferBytes);
+
+    m_thread = std::thread(&OutputWriter::WriterLoop, this);
+}
+
+// destructor to write out everything still buffered before the writer thread stops
+OutputWriter::~OutputWriter() {
+    Flush();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_filledReady.notify_one();
+    m_thread.join();
+
+    CloseDestination();
+}
+
+// method to flush the current destination and switch to a new one
+bool OutputWriter::Open(Destination destination, const std::string& target) {
+    const bool flushed = Flush();
+
+    const bool toFile = destination == Destination::File || destination == Destination::MappedFile;
+    if ((destination == m_destination && toFile && IsCurrentFile(target))
+        || (destination == Destination::Stdout && m_destination == Destination::Stdout && m_fd >= 0)) {
+        return flushed;
+    }
+
+    // a file opened earlier in the run carries on after the output already written to it
+    const std::string fileKey = toFile ? FileKey(target) : std::string();
+    const bool reopened = !fileKey.empty()
+        && std::find(m_openedFiles.begin(), m_openedFiles.end(), fileKey) != m_openedFiles.end();
+
+    int fd = -1;
+    bool ownsFd = true;
+    size_t mapSize = 0;
+
+#ifdef _WIN32
+    if (destination == Destination::File) {
+        fd = _open(target.c_str(), _O_WRONLY | _O_CREAT | (reopened ? _O_APPEND : _O_TRUNC) | _O_BINARY,
+            _S_IREAD | _S_IWRITE);
+    }
+    else if (destination == Destination::Stdout) {
+        fd = 1;
+        ownsFd = false;
+    }
+#else
+    // when the current destination is a mapped file being reopened as File, it is cut back to the
+    // bytes written by CloseDestination below, before any new output reaches it
+    if (destination == Destination::File) {
+        fd = open(target.c_str(), O_WRONLY | O_CREAT | (reopened ? O_APPEND : O_TRUNC) | O_CLOEXEC, 0644);
+    }
+    else if (destination == Destination::MappedFile) {
+        fd = open(target.c_str(), O_RDWR | O_CREAT | (reopened ? 0 : O_TRUNC) | O_CLOEXEC, 0644);
+        struct stat status;
+        if (fd >= 0 && reopened && fstat(fd, &status) == 0) {
+            mapSize = static_cast<size_t>(status.st_size);
+        }
+    }
+    else if (destination == Destination::Stdout) {
+        fd = STDOUT_FILENO;
+        ownsFd = false;
+    }
+    else {
+        fd = ConnectSocket(target);
+    }
+#endif
+
+    if (fd < 0) {
+        return false;
+    }
+
+    // the writer thread is idle after Flush, and stays idle until the next buffer is submitted
+    CloseDestination();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_failed = false;
+    }
+    m_destination = destination;
+    m_fd = fd;
+    m_ownsFd = ownsFd;
+    m_mapSize = mapSize;
+
+    // the key is taken again as a new file only exists once it has been opened
+    m_fileKey = toFile ? FileKey(target) : std::string();
+    if (!m_fileKey.empty()
+        && std::find(m_openedFiles.begin(), m_openedFiles.end(), m_fileKey) == m_openedFiles.end()) {
+        m_openedFiles.push_back(m_fileKey);
+    }
+
+    return flushed;
+}
+
+// method to check if target names the file the output is going to now
+bool OutputWriter::IsCurrentFile(const std::string& target) const {
+    return m_fd >= 0 && !m_fileKey.empty() && FileKey(target) == m_fileKey;
+}
+
+// method to identify a file, returns an empty string if there is no such file
+// POSIX uses the device and inode, so another path to the same file gives the same key,
+// Windows uses the full path name
+std::string OutputWriter::FileKey(const std::string& target) {
+#ifdef _WIN32
+    char path[_MAX_PATH];
+    return _fullpath(path, target.c_str(), _MAX_PATH) != nullptr ? std::string(path) : std::string();
+#else
+    struct stat status;
+    if (stat(target.c_str(), &status) != 0) {
+        return std::string();
+    }
+    return std::to_string(status.st_dev) + ":" + std::to_string(status.st_ino);
+#endif
+}
+
+// method to wait until everything written so far has reached the destination
+bool OutputWriter::Flush() {
+    Submit();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_bufferFreed.wait(lock, [this] { return m_filled.empty() && !m_writing; });
+    return !m_failed;
+}
+
+// method called by the stream when the current buffer is full
+std::streambuf::int_type OutputWriter::overflow(int_type ch) {
+    if (traits_type::eq_int_type(ch, traits_type::eof())) {
+        return traits_type::not_eof(ch);
+    }
+
+    if (pptr() == epptr()) {
+        Submit();
+    }
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+
+    return ch;
+}
+
+// method called by the stream to write a block of characters, copying straight into the buffers
+std::streamsize OutputWriter::xsputn(const char* data, std::streamsize count) {
+    std::streamsize written = 0;
+    while (written < count) {
+        if (pptr() == epptr()) {
+            Submit();
+        }
+        const std::streamsize chunk = std::min<std::streamsize>(epptr() - pptr(), count - written);
+        std::memcpy(pptr(), data + written, static_cast<size_t>(chunk));
+        pbump(static_cast<int>(chunk));
+        written += chunk;
+    }
+    return written;
+}
+
+// method called by the stream on flush, it queues the current buffer without waiting for the write
+int OutputWriter::sync() {
+    Submit();
+    return 0;
+}
+
+// method to queue the current buffer for the writer thread and continue in a free one
+// this is where the producer waits when every buffer is already queued
+void OutputWriter::Submit() {
+    const size_t used = static_cast<size_t>(pptr() - pbase());
+    if (used == 0) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_used[m_current] = used;
+    m_filled.push_back(m_current);
+    m_filledReady.notify_one();
+
+    m_bufferFreed.wait(lock, [this] { return !m_free.empty(); });
+    m_current = m_free.back();
+    m_free.pop_back();
+    setp(m_buffers[m_current].data(), m_buffers[m_current].data() + m_bufferBytes);
+}
+
+// method run by the writer thread, it takes every queued buffer at once so they go out in one write
+void OutputWriter::WriterLoop() {
+    std::vector<int> batch;
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        m_filledReady.wait(lock, [this] { return m_stopping || !m_filled.empty(); });
+        if (m_filled.empty()) {
+            return;
+        }
+
+        batch.assign(m_filled.begin(), m_filled.end());
+        m_filled.clear();
+        m_writing = true;
+
+        // after a failed write the rest of the output for this destination is dropped, not retried
+        const bool failed = m_failed;
+        lock.unlock();
+        const bool written = !failed && WriteBuffers(batch);
+        lock.lock();
+        m_failed = !written;
+
+        m_free.insert(m_free.end(), batch.begin(), batch.end());
+        m_writing = false;
+        m_bufferFreed.notify_all();
+    }
+}
+
+// method to write a batch of buffers to the destination, output is dropped if there is none
+// returns false if the destination fails, the writer thread latches that for Flush to report
+bool OutputWriter::WriteBuffers(const std::vector<int>& buffers) {
+    if (m_fd < 0) {
+        return true;
+    }
+
+#ifdef _WIN32
+    for (const int buffer : buffers) {
+        const char* data = m_buffers[buffer].data();
+        size_t remaining = m_used[buffer];
+        while (remaining > 0) {
+            const int written = _write(m_fd, data, static_cast<unsigned int>(remaining));
+            if (written <= 0) {
+                return false;
+            }
+            data += written;
+            remaining -= static_cast<size_t>(written);
+        }
+    }
+#else
+    if (m_destination == Destination::MappedFile) {
+        for (const int buffer : buffers) {
+            if (!WriteMapped(m_buffers[buffer].data(), m_used[buffer])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<iovec> vectors(buffers.size());
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        vectors[i].iov_base = m_buffers[buffers[i]].data();
+        vectors[i].iov_len = m_used[buffers[i]];
+    }
+
+    // writev may stop part way through, so skip what went out and go again
+    // sockets use sendmsg instead, which takes the same vectors and can be told not to raise SIGPIPE
+    iovec* next = vectors.data();
+    int remaining = static_cast<int>(vectors.size());
+    while (remaining > 0) {
+        ssize_t written;
+        if (m_destination == Destination::Socket) {
+            msghdr message;
+            std::memset(&message, 0, sizeof(message));
+            message.msg_iov = next;
+            message.msg_iovlen = remaining;
+            written = sendmsg(m_fd, &message, SEND_FLAGS);
+        }
+        else {
+            written = writev(m_fd, next, remaining);
+        }
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        while (remaining > 0 && static_cast<size_t>(written) >= next->iov_len) {
+            written -= static_cast<ssize_t>(next->iov_len);
+            ++next;
+            --remaining;
+        }
+        if (remaining > 0) {
+            next->iov_base = static_cast<char*>(next->iov_base) + written;
+            next->iov_len -= static_cast<size_t>(written);
+        }
+    }
+#endif
+
+    return true;
+}
+
+// method to copy data into the memory mapped file, growing the file and mapping by doubling
+bool OutputWriter::WriteMapped(const char* data, size_t size) {
+#ifdef _WIN32
+    (void)data;
+    (void)size;
+    return false;
+#else
+    if (m_mapSize + size > m_mapCapacity) {
+        const size_t capacity = std::max(std::max(m_mapCapacity * 2, m_mapSize + size), m_bufferBytes);
+        if (m_map != nullptr) {
+            munmap(m_map, m_mapCapacity);
+            m_map = nullptr;
+            m_mapCapacity = 0;
+        }
+        if (ftruncate(m_fd, static_cast<off_t>(capacity)) != 0) {
+            return false;
+        }
+        void* const map = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (map == MAP_FAILED) {
+            return false;
+        }
+        m_map = static_cast<char*>(map);
+        m_mapCapacity = capacity;
+    }
+
+    std::memcpy(m_map + m_mapSize, data, size);
+    m_mapSize += size;
+    return true;
+#endif
+}
+
+// method to close the destination, a memory mapped file is cut back to the bytes written
+void OutputWriter::CloseDestination() {
+#ifndef _WIN32
+    if (m_destination == Destination::MappedFile && m_fd >= 0) {
+        if (m_map != nullptr) {
+            munmap(m_map, m_mapCapacity);
+        }
+        // nothing more can be done if the file cannot be cut back while closing
+        const int truncated = ftruncate(m_fd, static_cast<off_t>(m_mapSize));
+        (void)truncated;
+    }
+#endif
+    m_map = nullptr;
+    m_mapCapacity = 0;
+    m_mapSize = 0;
+
+    if (m_fd >= 0 && m_ownsFd) {
+#ifdef _WIN32
+        _close(m_fd);
+#else
+        close(m_fd);
+#endif
+    }
+    m_fd = -1;
+    m_ownsFd = false;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+// output writer class
+// a stream buffer that collects output in large preallocated buffers and hands full ones to a
+// writer thread, so the thread producing output never waits on I/O unless every buffer is queued
+// (backpressure), in which case it waits for the writer thread to free one
+// the writer thread writes all queued buffers with a single writev, or copies them into a memory
+// mapped file, the destination can be a file, stdout, a TCP socket or a memory mapped file
+// sockets and memory mapped files are only available on POSIX systems
+class OutputWriter final : public std::streambuf {
+public:
+    enum class Destination { File, Stdout, Socket, MappedFile };
+
+    OutputWriter(size_t bufferBytes, int bufferCount);
+    ~OutputWriter() override;
+
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+
+    // method to flush the current destination and switch to a new one
+    // target is the file name for File and MappedFile, host:port for Socket and ignored for Stdout
+    // opening the current destination again does nothing, and a file this writer has opened before
+    // (as File or MappedFile) is appended to rather than truncated, so no output of this run is lost
+    // returns false, leaving the current destination in place, if the new one cannot be opened
+    // also returns false if output to the current destination was lost, but still switches then
+    bool Open(Destination destination, const std::string& target);
+
+    // method to wait until everything written so far has reached the destination
+    // returns false if a write to the current destination has failed, everything from the first
+    // failed write on is dropped until another destination is opened
+    bool Flush();
+
+protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char* data, std::streamsize count) override;
+    int sync() override;
+
+private:
+    void Submit();
+    void WriterLoop();
+    bool WriteBuffers(const std::vector<int>& buffers);
+    bool WriteMapped(const char* data, size_t size);
+    void CloseDestination();
+    bool IsCurrentFile(const std::string& target) const;
+    static std::string FileKey(const std::string& target);
+
+    const size_t m_bufferBytes;
+    std::vector<std::vector<char>> m_buffers;
+    std::vector<size_t> m_used;
+    std::deque<int> m_filled;
+    std::vector<int> m_free;
+    int m_current;
+
+    std::mutex m_mutex;
+    std::condition_variable m_filledReady;
+    std::condition_variable m_bufferFreed;
+    bool m_writing;
+    bool m_stopping;
+    bool m_failed;
+    std::thread m_thread;
+
+    // destination, only touched by the writer thread while it is writing
+    Destination m_destination;
+    int m_fd;
+    bool m_ownsFd;
+    char* m_map;
+    size_t m_mapCapacity;
+    size_t m_mapSize;
+
+    // FileKey of the current file (empty for other destinations) and of every file opened so far
+    std::string m_fileKey;
+    std::vector<std::string> m_openedFiles;
+};
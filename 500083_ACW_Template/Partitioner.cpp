@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+#include "Partitioner.h"
+#include "Navigation.h"
+
+// method to assign every node to a shard by recursive coordinate bisection
+std::vector<int> Partitioner::SplitGeographic(const std::vector<const Node*>& nodes, int shardCount) {
+    std::vector<int> shardOf(nodes.size(), 0);
+    std::vector<int> indices(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        indices[i] = static_cast<int>(i);
+    }
+
+    if (shardCount > 1 && !nodes.empty()) {
+        Bisect(nodes, indices, 0, indices.size(), 0, shardCount, shardOf);
+    }
+
+    return shardOf;
+}
+
+// method to split indices[first, last) between shardCount shards
+// the range is cut across its wider axis, with the cut placed so each side gets
+// a share of the nodes in proportion to the number of shards it will hold
+void Partitioner::Bisect(const std::vector<const Node*>& nodes, std::vector<int>& indices,
+    size_t first, size_t last, int firstShard, int shardCount, std::vector<int>& shardOf) {
+    if (shardCount == 1 || last - first <= 1) {
+        for (size_t i = first; i < last; ++i) {
+            shardOf[indices[i]] = firstShard;
+        }
+        return;
+    }
+
+    double minX = nodes[indices[first]]->GetX();
+    double maxX = minX;
+    double minY = nodes[indices[first]]->GetY();
+    double maxY = minY;
+    for (size_t i = first; i < last; ++i) {
+        const Node* const node = nodes[indices[i]];
+        minX = std::min(minX, node->GetX());
+        maxX = std::max(maxX, node->GetX());
+        minY = std::min(minY, node->GetY());
+        maxY = std::max(maxY, node->GetY());
+    }
+    const bool splitOnX = (maxX - minX) >= (maxY - minY);
+
+    const int leftShards = shardCount / 2;
+    const size_t middle = first + (last - first) * leftShards / shardCount;
+
+    std::nth_element(indices.begin() + first, indices.begin() + middle, indices.begin() + last,
+        [&nodes, splitOnX](int a, int b) {
+            return splitOnX ? nodes[a]->GetX() < nodes[b]->GetX() : nodes[a]->GetY() < nodes[b]->GetY();
+        });
+
+    Bisect(nodes, indices, first, middle, firstShard, leftShards, shardOf);
+    Bisect(nodes, indices, middle, last, firstShard + leftShards, shardCount - leftShards, shardOf);
+}
+
+// method to write the shard files
+// each link is written once, from the end with the lower reference, either to the links file
+// of the shard holding both ends or to the cut file when the ends are in different shards
+bool Partitioner::WriteShards(const std::vector<const Node*>& nodes, const std::vector<int>& shardOf,
+    int shardCount, const std::string& prefix) {
+    std::vector<std::ofstream> placesFiles;
+    std::vector<std::ofstream> linksFiles;
+    for (int shard = 0; shard < shardCount; ++shard) {
+        placesFiles.emplace_back(PlacesFileName(prefix, shard));
+        linksFiles.emplace_back(LinksFileName(prefix, shard));
+        if (placesFiles.back().fail() || linksFiles.back().fail()) {
+            return false;
+        }
+    }
+    std::ofstream cutFile(CutFileName(prefix));
+    if (cutFile.fail()) {
+        return false;
+    }
+
+    for (const Node* const node : nodes) {
+        const int shard = shardOf[node->GetIndex()];
+        bool boundary = false;
+
+        for (const auto& pair : node->GetNeighbours()) {
+            const Node* const neighbour = pair.first;
+            const bool cut = shardOf[neighbour->GetIndex()] != shard;
+            boundary = boundary || cut;
+
+            if (node->GetReference() < neighbour->GetReference()) {
+                std::ofstream& file = cut ? cutFile : linksFiles[shard];
+                file << node->GetReference() << "," << neighbour->GetReference() << ","
+                    << static_cast<int>(pair.second.mode) << "\n";
+            }
+        }
+
+        placesFiles[shard] << node->GetName() << "," << node->GetReference() << ","
+            << std::fixed << std::setprecision(3) << node->GetX() << "," << node->GetY() << ","
+            << (boundary ? 1 : 0) << "\n";
+    }
+
+    return true;
+}
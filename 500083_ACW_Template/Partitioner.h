@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+class Node;
+
+// partitioner class
+// splits the network into geographic shards and writes each shard to its own files
+// so that shard workers can load them without access to the full network
+//
+// files written for a prefix P and shard i:
+//   P<i>_Places.csv  name,reference,x,y,boundary (x and y are the UTM coordinates, boundary is 1 if the
+//                    place has a link into another shard)
+//   P<i>_Links.csv   startRef,endRef,mode for links inside the shard (mode is the TransportMode value)
+//   P_Cut.csv        startRef,endRef,mode for links that cross between shards
+class Partitioner final {
+public:
+    // method to assign every node to a shard by recursive coordinate bisection
+    // the returned vector is indexed by node index and holds the shard number
+    static std::vector<int> SplitGeographic(const std::vector<const Node*>& nodes, int shardCount);
+
+    // method to write the shard files, returns false if a file could not be written
+    static bool WriteShards(const std::vector<const Node*>& nodes, const std::vector<int>& shardOf,
+        int shardCount, const std::string& prefix);
+
+    // method to build the file names used by WriteShards
+    static std::string PlacesFileName(const std::string& prefix, int shard) {
+        return prefix + std::to_string(shard) + "_Places.csv";
+    }
+    static std::string LinksFileName(const std::string& prefix, int shard) {
+        return prefix + std::to_string(shard) + "_Links.csv";
+    }
+    static std::string CutFileName(const std::string& prefix) {
+        return prefix + "_Cut.csv";
+    }
+
+private:
+    static void Bisect(const std::vector<const Node*>& nodes, std::vector<int>& indices,
+        size_t first, size_t last, int firstShard, int shardCount, std::vector<int>& shardOf);
+};
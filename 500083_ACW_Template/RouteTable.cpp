@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "RouteTable.h"
+
+namespace {
+    // sources searched together in one pass, one bit each
+    // the words of a node are or'ed together in fixed size loops the compiler turns into SIMD
+    constexpr int BATCH_WORDS = 4;
+    constexpr int BATCH_SOURCES = BATCH_WORDS * 64;
+    using SourceBits = std::array<std::uint64_t, BATCH_WORDS>;
+
+    constexpr std::uint16_t NO_NEXT_HOP = 0xFFFF;
+
+    // method to get the position of the lowest set bit of a non zero word
+    inline int LowestBit(std::uint64_t word) {
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanForward64(&index, word);
+        return static_cast<int>(index);
+#elif defined(_MSC_VER)
+        unsigned long index;
+        if (_BitScanForward(&index, static_cast<unsigned long>(word))) {
+            return static_cast<int>(index);
+        }
+        _BitScanForward(&index, static_cast<unsigned long>(word >> 32));
+        return static_cast<int>(index) + 32;
+#else
+        return __builtin_ctzll(word);
+#endif
+    }
+}
+
+// method to estimate the memory Build would use for a mode graph
+size_t RouteTable::EstimateBytes(const ModeGraph& graph) {
+    size_t count = 0;
+    for (int node = 0; node < graph.GetNodeCount(); ++node) {
+        if (graph.GetDegree(node) > 0) {
+            ++count;
+        }
+    }
+
+    if (count >= NO_NEXT_HOP) {
+        return std::numeric_limits<size_t>::max();
+    }
+    return count * count * (sizeof(std::uint8_t) + sizeof(std::uint16_t))
+        + (graph.GetNodeCount() + count) * sizeof(int);
+}
+
+// method to fill the tables using bit parallel multi source BFS
+// each pass runs a BFS from up to BATCH_SOURCES sources at once, every node holds one bit per source
+// for its visited set and the frontier, so one level is an or over the arcs for all sources together
+// the graph is undirected so the hop table is symmetric, a node reached at a level is written to
+// its own row, then the next hop from s towards t is a neighbour u of s with hops(u,t) = hops(s,t) - 1
+bool RouteTable::Build(const ModeGraph& graph) {
+    Clear();
+
+    const int nodeCount = graph.GetNodeCount();
+    m_localIndex.assign(nodeCount, -1);
+    for (int node = 0; node < nodeCount; ++node) {
+        if (graph.GetDegree(node) > 0) {
+            m_localIndex[node] = static_cast<int>(m_globalIndex.size());
+            m_globalIndex.push_back(node);
+        }
+    }
+
+    const int count = static_cast<int>(m_globalIndex.size());
+    if (count >= NO_NEXT_HOP) {
+        Clear();
+        return false;
+    }
+
+    // adjacency in local indices
+    std::vector<int> offsets(1, 0);
+    std::vector<int> targets;
+    offsets.reserve(count + 1);
+    for (const int node : m_globalIndex) {
+        for (const int* it = graph.NeighboursBegin(node); it != graph.NeighboursEnd(node); ++it) {
+            targets.push_back(m_localIndex[*it]);
+        }
+        offsets.push_back(static_cast<int>(targets.size()));
+    }
+
+    const size_t pairCount = static_cast<size_t>(count) * count;
+    m_hops.assign(pairCount, static_cast<std::uint8_t>(UNREACHABLE));
+
+    std::vector<SourceBits> visited(count);
+    std::vector<SourceBits> frontier(count);
+    std::vector<SourceBits> next(count);
+
+    for (int batchStart = 0; batchStart < count; batchStart += BATCH_SOURCES) {
+        const int batchSize = std::min(BATCH_SOURCES, count - batchStart);
+
+        const SourceBits empty = {};
+        std::fill(visited.begin(), visited.end(), empty);
+        std::fill(frontier.begin(), frontier.end(), empty);
+        for (int i = 0; i < batchSize; ++i) {
+            const int source = batchStart + i;
+            visited[source][i / 64] |= std::uint64_t(1) << (i % 64);
+            frontier[source][i / 64] |= std::uint64_t(1) << (i % 64);
+            m_hops[static_cast<size_t>(source) * count + source] = 0;
+        }
+
+        for (int level = 1; ; ++level) {
+            bool reachedAny = false;
+
+            for (int node = 0; node < count; ++node) {
+                SourceBits reached = {};
+                for (int arc = offsets[node]; arc < offsets[node + 1]; ++arc) {
+                    const SourceBits& bits = frontier[targets[arc]];
+                    for (int w = 0; w < BATCH_WORDS; ++w) {
+                        reached[w] |= bits[w];
+                    }
+                }
+
+                for (int w = 0; w < BATCH_WORDS; ++w) {
+                    reached[w] &= ~visited[node][w];
+                    visited[node][w] |= reached[w];
+                }
+                next[node] = reached;
+
+                // the row of this node holds its hops from every source
+                std::uint8_t* const row = m_hops.data() + static_cast<size_t>(node) * count + batchStart;
+                for (int w = 0; w < BATCH_WORDS; ++w) {
+                    std::uint64_t word = reached[w];
+                    if (word == 0) {
+                        continue;
+                    }
+                    // a route this long does not fit the hop table
+                    if (level >= UNREACHABLE) {
+                        Clear();
+                        return false;
+                    }
+                    reachedAny = true;
+                    while (word != 0) {
+                        row[w * 64 + LowestBit(word)] = static_cast<std::uint8_t>(level);
+                        word &= word - 1;
+                    }
+                }
+            }
+
+            if (!reachedAny) {
+                break;
+            }
+            frontier.swap(next);
+        }
+    }
+
+    // next hops, neighbours are tried last to first so the first matching neighbour wins
+    m_nextHop.assign(pairCount, NO_NEXT_HOP);
+    for (int source = 0; source < count; ++source) {
+        const std::uint8_t* const sourceRow = m_hops.data() + static_cast<size_t>(source) * count;
+        std::uint16_t* const nextRow = m_nextHop.data() + static_cast<size_t>(source) * count;
+
+        for (int arc = offsets[source + 1] - 1; arc >= offsets[source]; --arc) {
+            const int neighbour = targets[arc];
+            const std::uint8_t* const neighbourRow = m_hops.data() + static_cast<size_t>(neighbour) * count;
+            for (int target = 0; target < count; ++target) {
+                const bool closer = neighbourRow[target] + 1 == sourceRow[target];
+                nextRow[target] = closer ? static_cast<std::uint16_t>(neighbour) : nextRow[target];
+            }
+        }
+    }
+
+    m_built = true;
+    return true;
+}
+
+// method to free the tables
+void RouteTable::Clear() {
+    std::vector<int>().swap(m_localIndex);
+    std::vector<int>().swap(m_globalIndex);
+    std::vector<std::uint8_t>().swap(m_hops);
+    std::vector<std::uint16_t>().swap(m_nextHop);
+    m_built = false;
+}
+
+// method to fill route with node indices from start to end by following the next hops
+bool RouteTable::FindRoute(int start, int end, std::vector<int>& route) const {
+    route.clear();
+
+    if (start == end) {
+        route.push_back(start);
+        return true;
+    }
+
+    const int localStart = m_localIndex[start];
+    const int localEnd = m_localIndex[end];
+    if (localStart < 0 || localEnd < 0) {
+        return false;
+    }
+
+    const size_t count = m_globalIndex.size();
+    if (m_hops[localStart * count + localEnd] == UNREACHABLE) {
+        return false;
+    }
+
+    for (int node = localStart; node != localEnd; node = m_nextHop[node * count + localEnd]) {
+        route.push_back(m_globalIndex[node]);
+    }
+    route.push_back(m_globalIndex[localEnd]);
+
+    return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ModeGraph.h"
+
+// route table class
+// all pairs hop counts and next hops for one mode graph, so a shortest route query is answered
+// by following next hops with no search at all
+// only nodes with arcs in the mode get a row and column, the tables take 3 bytes per pair
+class RouteTable final {
+public:
+    static constexpr std::uint8_t UNREACHABLE = 0xFF;
+
+    RouteTable() : m_localIndex(), m_globalIndex(), m_hops(), m_nextHop(), m_built(false) {}
+
+    // method to estimate the memory Build would use for a mode graph
+    static size_t EstimateBytes(const ModeGraph& graph);
+
+    // method to fill the tables, returns false (and builds nothing) if a route is
+    // too long for the hop table or there are too many nodes for the next hop table
+    bool Build(const ModeGraph& graph);
+
+    // method to free the tables
+    void Clear();
+
+    // method to fill route with node indices from start to end, returns false if there is no route
+    bool FindRoute(int start, int end, std::vector<int>& route) const;
+
+    // getters
+    bool IsBuilt() const { return m_built; }
+    size_t GetMemoryBytes() const {
+        return m_hops.capacity() * sizeof(std::uint8_t) + m_nextHop.capacity() * sizeof(std::uint16_t)
+            + (m_localIndex.capacity() + m_globalIndex.capacity()) * sizeof(int);
+    }
+
+private:
+    // -1 for nodes without arcs in this mode
+    std::vector<int> m_localIndex;
+    std::vector<int> m_globalIndex;
+    // source major, m_hops[source * count + target]
+    std::vector<std::uint8_t> m_hops;
+    std::vector<std::uint16_t> m_nextHop;
+    bool m_built;
+};
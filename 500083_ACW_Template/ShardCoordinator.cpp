@@ -0,0 +1,696 @@
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <sstream>
+#include <utility>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+#include "ShardCoordinator.h"
+#include "ShardWorker.h"
+#include "Partitioner.h"
+
+// socket protocol, every request is four ints (operation, mode, a, b)
+// every response is an int count followed by that many ints
+namespace {
+    constexpr int OP_QUIT = 0;
+    constexpr int OP_BOUNDARY_HOPS = 1;
+    constexpr int OP_ROUTE = 2;
+
+#ifndef _WIN32
+    // file descriptor of the socket in a worker process
+    constexpr int WORKER_FD = 3;
+
+    // environment variables naming the shard files and arc masks of a worker process
+    const char* const WORKER_VARIABLE_PREFIX = "NAVIGATION_SHARD_";
+    const char* const WORKER_PLACES_VARIABLE = "NAVIGATION_SHARD_PLACES";
+    const char* const WORKER_LINKS_VARIABLE = "NAVIGATION_SHARD_LINKS";
+    const char* const WORKER_MASKS_VARIABLE = "NAVIGATION_SHARD_MASKS";
+
+    // a peer that has gone away must show up as a failed send rather than a SIGPIPE
+#ifdef MSG_NOSIGNAL
+    constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    constexpr int SEND_FLAGS = 0;
+#endif
+
+    // method to prepare one end of a worker socket, it is closed on exec so later workers do not
+    // inherit it, and where send has no MSG_NOSIGNAL the socket is told not to raise SIGPIPE instead
+    bool PrepareSocket(int fd) {
+#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+        const int on = 1;
+        if (setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on)) != 0) {
+            return false;
+        }
+#endif
+        return fcntl(fd, F_SETFD, FD_CLOEXEC) == 0;
+    }
+
+    // method to write all bytes, retrying after partial writes and signals
+    bool WriteAll(int fd, const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+            const ssize_t written = send(fd, bytes, size, SEND_FLAGS);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            bytes += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    // method to read exactly size bytes, returns false on error or end of file
+    bool ReadAll(int fd, void* data, size_t size) {
+        char* bytes = static_cast<char*>(data);
+        while (size > 0) {
+            const ssize_t got = read(fd, bytes, size);
+            if (got < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            if (got == 0) {
+                return false;
+            }
+            bytes += got;
+            size -= static_cast<size_t>(got);
+        }
+        return true;
+    }
+
+    // method to write a count prefixed response
+    bool WriteResponse(int fd, const std::vector<int>& data) {
+        const int count = static_cast<int>(data.size());
+        return WriteAll(fd, &count, sizeof(count)) && WriteAll(fd, data.data(), data.size() * sizeof(int));
+    }
+
+    // method run by a worker process, it loads its shard then serves requests until told to quit
+    void RunWorker(int fd, const std::string& placesFile, const std::string& linksFile,
+        const unsigned int* arcMasks, int modeCount) {
+        ShardWorker worker(arcMasks, modeCount);
+        std::vector<int> response(1, worker.Load(placesFile, linksFile) ? 1 : 0);
+        if (!WriteResponse(fd, response) || response[0] == 0) {
+            return;
+        }
+
+        std::vector<std::pair<int, int>> hops;
+        std::vector<int> route;
+        int request[4];
+        while (ReadAll(fd, request, sizeof(request)) && request[0] != OP_QUIT) {
+            response.clear();
+            if (request[0] == OP_BOUNDARY_HOPS) {
+                worker.FindBoundaryHops(request[1], request[2], hops);
+                for (const auto& pair : hops) {
+                    response.push_back(pair.first);
+                    response.push_back(pair.second);
+                }
+            }
+            else if (request[0] == OP_ROUTE) {
+                worker.FindShortestRoute(request[1], request[2], request[3], route);
+                response = route;
+            }
+            if (!WriteResponse(fd, response)) {
+                return;
+            }
+        }
+    }
+
+    // method to close every file descriptor above WORKER_FD in a worker process
+    // the coordinator marks its own as close on exec, this catches any opened without it by the rest of the program
+    void CloseInheritedFds() {
+        std::vector<int> inherited;
+        DIR* const directory = opendir("/dev/fd");
+        if (directory == nullptr) {
+            return;
+        }
+        for (const dirent* entry = readdir(directory); entry != nullptr; entry = readdir(directory)) {
+            const int fd = std::atoi(entry->d_name);
+            if (fd > WORKER_FD && fd != dirfd(directory)) {
+                inherited.push_back(fd);
+            }
+        }
+        closedir(directory);
+
+        for (const int fd : inherited) {
+            close(fd);
+        }
+    }
+
+    // worker entry point, constructed before main runs
+    // in a process started by ShardCoordinator::Start it serves its shard and exits without returning,
+    // in any other process the worker variables are not set and it does nothing
+    struct WorkerEntry {
+        WorkerEntry() {
+            const char* const placesFile = std::getenv(WORKER_PLACES_VARIABLE);
+            const char* const linksFile = std::getenv(WORKER_LINKS_VARIABLE);
+            const char* const masks = std::getenv(WORKER_MASKS_VARIABLE);
+            if (placesFile == nullptr || linksFile == nullptr || masks == nullptr) {
+                return;
+            }
+
+            std::vector<unsigned int> arcMasks;
+            std::istringstream iss(masks);
+            unsigned int mask;
+            while (iss >> mask) {
+                arcMasks.push_back(mask);
+                iss.ignore();
+            }
+
+            CloseInheritedFds();
+            RunWorker(WORKER_FD, placesFile, linksFile, arcMasks.data(), static_cast<int>(arcMasks.size()));
+            _exit(0);
+        }
+    };
+
+    const WorkerEntry workerEntry;
+#endif
+}
+
+// constructor
+ShardCoordinator::ShardCoordinator()
+    : m_workers(),
+    m_shardOf(),
+    m_overlayIndex(),
+    m_overlayRefs(),
+    m_overlay(),
+    m_cutLinkCount(0),
+    m_workDirectory()
+{
+}
+
+// destructor to make sure no worker process is left running
+ShardCoordinator::~ShardCoordinator() {
+    Stop();
+}
+
+// method to check if worker processes can be started on this system
+// a worker is started from /proc/self/exe, which only Linux provides
+bool ShardCoordinator::IsSupported() {
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+// method to create a new temporary directory for the shard files
+std::string ShardCoordinator::CreateWorkDirectory() {
+#ifdef _WIN32
+    return std::string();
+#else
+    const char* const tempDirectory = std::getenv("TMPDIR");
+    std::string path = std::string(tempDirectory != nullptr && tempDirectory[0] != '\0' ? tempDirectory : "/tmp")
+        + "/navigation_shards.XXXXXX";
+    if (mkdtemp(&path[0]) == nullptr) {
+        return std::string();
+    }
+
+    m_workDirectory = path;
+    return m_workDirectory + "/Shard";
+#endif
+}
+
+// method to start the workers and build the overlay
+// the shard places files are read here first so the coordinator knows which shard holds each place,
+// then one worker is spawned per shard and loads its own files
+// workers are started with posix_spawn rather than fork, as the output writer thread is already
+// running and only the thread calling fork would exist in the child
+// Stop must have been called before the shard files were written, as it removes the work directory
+bool ShardCoordinator::Start(const std::string& prefix, int shardCount, const unsigned int* arcMasks, int modeCount) {
+#ifdef _WIN32
+    (void)prefix;
+    (void)shardCount;
+    (void)arcMasks;
+    (void)modeCount;
+    return false;
+#else
+    if (!IsSupported()) {
+        return false;
+    }
+
+    m_workers.resize(shardCount);
+    for (int shard = 0; shard < shardCount; ++shard) {
+        if (!LoadShardPlaces(Partitioner::PlacesFileName(prefix, shard), shard)) {
+            Stop();
+            return false;
+        }
+    }
+
+    char executable[4096];
+    const ssize_t executableLength = readlink("/proc/self/exe", executable, sizeof(executable) - 1);
+    if (executableLength <= 0) {
+        Stop();
+        return false;
+    }
+    executable[executableLength] = '\0';
+    char* const arguments[] = { executable, nullptr };
+
+    // the worker environment is this one plus the worker variables, the last two are set per shard
+    std::vector<std::string> environment;
+    const size_t prefixLength = std::strlen(WORKER_VARIABLE_PREFIX);
+    for (char** variable = environ; *variable != nullptr; ++variable) {
+        if (std::strncmp(*variable, WORKER_VARIABLE_PREFIX, prefixLength) != 0) {
+            environment.push_back(*variable);
+        }
+    }
+    std::ostringstream masks;
+    for (int mode = 0; mode < modeCount; ++mode) {
+        masks << (mode > 0 ? "," : "") << arcMasks[mode];
+    }
+    environment.push_back(std::string(WORKER_MASKS_VARIABLE) + "=" + masks.str());
+    environment.push_back(std::string());
+    environment.push_back(std::string());
+
+    for (int shard = 0; shard < shardCount; ++shard) {
+        environment[environment.size() - 2] = std::string(WORKER_PLACES_VARIABLE) + "="
+            + Partitioner::PlacesFileName(prefix, shard);
+        environment[environment.size() - 1] = std::string(WORKER_LINKS_VARIABLE) + "="
+            + Partitioner::LinksFileName(prefix, shard);
+        std::vector<char*> environmentPointers;
+        for (std::string& variable : environment) {
+            environmentPointers.push_back(&variable[0]);
+        }
+        environmentPointers.push_back(nullptr);
+
+        int sockets[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+            Stop();
+            return false;
+        }
+        m_workers[shard].fd = sockets[0];
+        if (!PrepareSocket(sockets[0]) || !PrepareSocket(sockets[1])) {
+            close(sockets[1]);
+            Stop();
+            return false;
+        }
+
+        // dup2 onto WORKER_FD clears close on exec in the worker, but not if the end already is WORKER_FD
+        if (sockets[1] == WORKER_FD) {
+            const int moved = fcntl(sockets[1], F_DUPFD_CLOEXEC, WORKER_FD + 1);
+            close(sockets[1]);
+            sockets[1] = moved;
+            if (moved < 0) {
+                Stop();
+                return false;
+            }
+        }
+
+        pid_t pid = -1;
+        posix_spawn_file_actions_t actions;
+        if (posix_spawn_file_actions_init(&actions) != 0) {
+            close(sockets[1]);
+            Stop();
+            return false;
+        }
+        const bool spawned = posix_spawn_file_actions_adddup2(&actions, sockets[1], WORKER_FD) == 0
+            && posix_spawn(&pid, executable, &actions, nullptr, arguments, environmentPointers.data()) == 0;
+        posix_spawn_file_actions_destroy(&actions);
+        close(sockets[1]);
+
+        if (!spawned) {
+            Stop();
+            return false;
+        }
+        m_workers[shard].pid = static_cast<int>(pid);
+    }
+
+    // every worker reports whether it loaded its shard
+    std::vector<int> response;
+    for (int shard = 0; shard < shardCount; ++shard) {
+        if (!ReadResponse(shard, response) || response.size() != 1 || response[0] != 1) {
+            Stop();
+            return false;
+        }
+    }
+
+    if (!BuildOverlay(Partitioner::CutFileName(prefix), arcMasks, modeCount)) {
+        Stop();
+        return false;
+    }
+
+    return true;
+#endif
+}
+
+// method to stop all workers and forget the overlay
+void ShardCoordinator::Stop() {
+#ifndef _WIN32
+    for (size_t shard = 0; shard < m_workers.size(); ++shard) {
+        WorkerProcess& worker = m_workers[shard];
+        if (worker.fd >= 0) {
+            SendRequest(static_cast<int>(shard), OP_QUIT, 0, 0, 0);
+            close(worker.fd);
+        }
+        if (worker.pid > 0) {
+            waitpid(static_cast<pid_t>(worker.pid), nullptr, 0);
+        }
+    }
+#endif
+
+    m_workers.clear();
+    m_shardOf.clear();
+    m_overlayIndex.clear();
+    m_overlayRefs.clear();
+    m_overlay.clear();
+    m_cutLinkCount = 0;
+
+#ifndef _WIN32
+    // the work directory only ever holds shard files
+    if (!m_workDirectory.empty()) {
+        DIR* const directory = opendir(m_workDirectory.c_str());
+        if (directory != nullptr) {
+            for (const dirent* entry = readdir(directory); entry != nullptr; entry = readdir(directory)) {
+                const std::string name = entry->d_name;
+                if (name != "." && name != "..") {
+                    unlink((m_workDirectory + "/" + name).c_str());
+                }
+            }
+            closedir(directory);
+        }
+        rmdir(m_workDirectory.c_str());
+    }
+#endif
+    m_workDirectory.clear();
+}
+
+// method to read a shard places file for the shard of each place and the boundary places
+bool ShardCoordinator::LoadShardPlaces(const std::string& fileName, int shard) {
+    std::ifstream finPlaces(fileName);
+    if (finPlaces.fail()) {
+        return false;
+    }
+
+    WorkerProcess& worker = m_workers[shard];
+    worker.nodeCount = 0;
+    worker.boundary.clear();
+
+    std::string line;
+    while (std::getline(finPlaces, line)) {
+        std::string name;
+        int reference;
+        double x, y;
+        int boundary;
+        std::istringstream iss(line);
+        std::getline(iss, name, ',');
+        iss >> reference;
+        iss.ignore();
+        iss >> x;
+        iss.ignore();
+        iss >> y;
+        iss.ignore();
+        iss >> boundary;
+
+        m_shardOf[reference] = shard;
+        ++worker.nodeCount;
+        if (boundary != 0) {
+            worker.boundary.push_back(reference);
+            m_overlayIndex[reference] = static_cast<int>(m_overlayRefs.size());
+            m_overlayRefs.push_back(reference);
+        }
+    }
+
+    return true;
+}
+
+// method to build the overlay graph for every mode
+// links between shards come from the cut file, the hops between boundary places of the same shard
+// are requested from the workers, one boundary place per shard at a time so the workers run in parallel
+bool ShardCoordinator::BuildOverlay(const std::string& cutFileName, const unsigned int* arcMasks, int modeCount) {
+    std::ifstream finCut(cutFileName);
+    if (finCut.fail()) {
+        return false;
+    }
+
+    m_overlay.assign(modeCount, std::vector<std::vector<OverlayArc>>(m_overlayRefs.size()));
+
+    std::string line;
+    while (std::getline(finCut, line)) {
+        int startRef, endRef, arcMode;
+        std::istringstream iss(line);
+        iss >> startRef;
+        iss.ignore();
+        iss >> endRef;
+        iss.ignore();
+        iss >> arcMode;
+
+        const auto startIter = m_overlayIndex.find(startRef);
+        const auto endIter = m_overlayIndex.find(endRef);
+        if (startIter == m_overlayIndex.end() || endIter == m_overlayIndex.end()) {
+            continue;
+        }
+
+        ++m_cutLinkCount;
+        for (int mode = 0; mode < modeCount; ++mode) {
+            if ((arcMasks[mode] >> arcMode) & 1u) {
+                m_overlay[mode][startIter->second].push_back({ endIter->second, 1, -1 });
+                m_overlay[mode][endIter->second].push_back({ startIter->second, 1, -1 });
+            }
+        }
+    }
+
+    size_t maxBoundary = 0;
+    for (const WorkerProcess& worker : m_workers) {
+        maxBoundary = std::max(maxBoundary, worker.boundary.size());
+    }
+
+    const int shardCount = GetShardCount();
+    std::vector<int> response;
+    for (int mode = 0; mode < modeCount; ++mode) {
+        for (size_t round = 0; round < maxBoundary; ++round) {
+            for (int shard = 0; shard < shardCount; ++shard) {
+                const std::vector<int>& boundary = m_workers[shard].boundary;
+                if (round < boundary.size() && !SendRequest(shard, OP_BOUNDARY_HOPS, mode, boundary[round], 0)) {
+                    return false;
+                }
+            }
+
+            for (int shard = 0; shard < shardCount; ++shard) {
+                const std::vector<int>& boundary = m_workers[shard].boundary;
+                if (round >= boundary.size()) {
+                    continue;
+                }
+                if (!ReadResponse(shard, response)) {
+                    return false;
+                }
+
+                const int from = m_overlayIndex.find(boundary[round])->second;
+                for (size_t i = 0; i + 1 < response.size(); i += 2) {
+                    const auto toIter = m_overlayIndex.find(response[i]);
+                    if (toIter == m_overlayIndex.end()) {
+                        return false;
+                    }
+                    if (toIter->second != from) {
+                        m_overlay[mode][from].push_back({ toIter->second, response[i + 1], shard });
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// method to send a request to a worker
+bool ShardCoordinator::SendRequest(int shard, int operation, int mode, int a, int b) {
+#ifdef _WIN32
+    (void)shard;
+    (void)operation;
+    (void)mode;
+    (void)a;
+    (void)b;
+    return false;
+#else
+    const int request[4] = { operation, mode, a, b };
+    return WriteAll(m_workers[shard].fd, request, sizeof(request));
+#endif
+}
+
+// method to read the next response from a worker
+bool ShardCoordinator::ReadResponse(int shard, std::vector<int>& data) {
+#ifdef _WIN32
+    (void)shard;
+    data.clear();
+    return false;
+#else
+    int count = 0;
+    if (!ReadAll(m_workers[shard].fd, &count, sizeof(count)) || count < 0) {
+        return false;
+    }
+    data.resize(count);
+    return ReadAll(m_workers[shard].fd, data.data(), data.size() * sizeof(int));
+#endif
+}
+
+// method to ask a worker for the route between two places of its shard
+bool ShardCoordinator::RequestRoute(int shard, int mode, int startRef, int endRef, std::vector<int>& route) {
+    return SendRequest(shard, OP_ROUTE, mode, startRef, endRef) && ReadResponse(shard, route) && !route.empty();
+}
+
+// method to find the route with the fewest hops between two places
+// the start and end workers are queried at the same time for their boundary hops, and for the
+// direct route when both places are in one shard, the overlay search then has to beat that route
+// a failed send or read, or a reply that does not fit the overlay, may leave replies unread in other
+// sockets, so every worker is stopped rather than risk a later query reading a stale reply
+bool ShardCoordinator::FindShortestRoute(int mode, int startRef, int endRef, std::vector<int>& route) {
+    route.clear();
+
+    const auto startIter = m_shardOf.find(startRef);
+    const auto endIter = m_shardOf.find(endRef);
+    if (startIter == m_shardOf.end() || endIter == m_shardOf.end() || mode < 0
+        || mode >= static_cast<int>(m_overlay.size())) {
+        return false;
+    }
+    if (startRef == endRef) {
+        route.push_back(startRef);
+        return true;
+    }
+
+    const int startShard = startIter->second;
+    const int endShard = endIter->second;
+    const bool sameShard = startShard == endShard;
+
+    std::vector<int> startHops;
+    std::vector<int> endHops;
+    std::vector<int> direct;
+    if (!SendRequest(startShard, OP_BOUNDARY_HOPS, mode, startRef, 0)
+        || !SendRequest(endShard, OP_BOUNDARY_HOPS, mode, endRef, 0)
+        || (sameShard && !SendRequest(startShard, OP_ROUTE, mode, startRef, endRef))
+        || !ReadResponse(startShard, startHops)
+        || !ReadResponse(endShard, endHops)
+        || (sameShard && !ReadResponse(startShard, direct))
+        || startHops.size() % 2 != 0 || endHops.size() % 2 != 0) {
+        Stop();
+        return false;
+    }
+
+    constexpr int INFINITE_HOPS = std::numeric_limits<int>::max();
+    int bestHops = direct.empty() ? INFINITE_HOPS : static_cast<int>(direct.size()) - 1;
+    int bestExit = -1;
+
+    // hops from each boundary place of the end shard to the end place
+    std::unordered_map<int, int> exitHops;
+    for (size_t i = 0; i + 1 < endHops.size(); i += 2) {
+        const auto exitIter = m_overlayIndex.find(endHops[i]);
+        if (exitIter == m_overlayIndex.end()) {
+            Stop();
+            return false;
+        }
+        exitHops[exitIter->second] = endHops[i + 1];
+    }
+
+    // Dijkstra over the overlay, seeded with the hops from the start place to its boundary places
+    const std::vector<std::vector<OverlayArc>>& overlay = m_overlay[mode];
+    std::vector<int> dist(m_overlayRefs.size(), INFINITE_HOPS);
+    std::vector<int> previous(m_overlayRefs.size(), -1);
+    std::vector<int> previousShard(m_overlayRefs.size(), -1);
+    using OpenEntry = std::pair<int, int>;
+    std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> open;
+
+    for (size_t i = 0; i + 1 < startHops.size(); i += 2) {
+        const auto entryIter = m_overlayIndex.find(startHops[i]);
+        if (entryIter == m_overlayIndex.end()) {
+            Stop();
+            return false;
+        }
+        const int node = entryIter->second;
+        dist[node] = startHops[i + 1];
+        open.emplace(dist[node], node);
+    }
+
+    while (!open.empty()) {
+        const int cost = open.top().first;
+        const int current = open.top().second;
+        open.pop();
+
+        if (cost > dist[current]) {
+            continue;
+        }
+        // every further leg costs at least one hop, so nothing left can beat the best route
+        if (cost >= bestHops) {
+            break;
+        }
+
+        const auto exitIter = exitHops.find(current);
+        if (exitIter != exitHops.end() && cost + exitIter->second < bestHops) {
+            bestHops = cost + exitIter->second;
+            bestExit = current;
+        }
+
+        for (const OverlayArc& arc : overlay[current]) {
+            const int nextCost = cost + arc.hops;
+            if (nextCost < dist[arc.to]) {
+                dist[arc.to] = nextCost;
+                previous[arc.to] = current;
+                previousShard[arc.to] = arc.shard;
+                open.emplace(nextCost, arc.to);
+            }
+        }
+    }
+
+    if (bestExit < 0) {
+        route = direct;
+        return !route.empty();
+    }
+
+    // unpack the overlay route, intra shard legs are asked for from their workers
+    // the chain visits each overlay node at most once, a longer one means the previous links are broken
+    std::vector<int> chain;
+    for (int node = bestExit; node != -1; node = previous[node]) {
+        if (chain.size() == m_overlayRefs.size()) {
+            Stop();
+            return false;
+        }
+        chain.push_back(node);
+    }
+    std::reverse(chain.begin(), chain.end());
+
+    std::vector<int> leg;
+    if (!RequestRoute(startShard, mode, startRef, m_overlayRefs[chain.front()], leg)) {
+        Stop();
+        return false;
+    }
+    route = leg;
+
+    for (size_t i = 1; i < chain.size(); ++i) {
+        const int shard = previousShard[chain[i]];
+        if (shard < 0) {
+            route.push_back(m_overlayRefs[chain[i]]);
+            continue;
+        }
+        if (!RequestRoute(shard, mode, m_overlayRefs[chain[i - 1]], m_overlayRefs[chain[i]], leg)) {
+            route.clear();
+            Stop();
+            return false;
+        }
+        route.insert(route.end(), leg.begin() + 1, leg.end());
+    }
+
+    if (!RequestRoute(endShard, mode, m_overlayRefs[chain.back()], endRef, leg)) {
+        route.clear();
+        Stop();
+        return false;
+    }
+    route.insert(route.end(), leg.begin() + 1, leg.end());
+
+    return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// shard coordinator class
+// starts one worker process per shard written by the Partitioner and answers route queries by
+// stitching together per shard searches with an overlay graph of the boundary places
+//
+// the overlay holds, for every mode, the links that cross between shards (one hop each) plus the
+// fewest hops between each pair of boundary places of the same shard, as reported by its worker
+// a query asks the start and end shards for their hops to their boundary places, runs Dijkstra over
+// the overlay between the two sets, then asks the workers for the route of each intra shard leg
+//
+// workers are local processes that only talk to the coordinator through a socket, standing in for
+// remote machines, this is only available on Linux
+// a worker is this program executed again with its shard files named in the environment, it is
+// picked up by a static object in ShardCoordinator.cpp before main runs, so the worker starts from a
+// fresh process image instead of a fork of a process that may already be running other threads
+class ShardCoordinator final {
+public:
+    ShardCoordinator();
+    ~ShardCoordinator();
+
+    ShardCoordinator(const ShardCoordinator&) = delete;
+    ShardCoordinator& operator=(const ShardCoordinator&) = delete;
+
+    // method to check if worker processes can be started on this system
+    static bool IsSupported();
+
+    // method to create a new temporary directory for the shard files, returns the prefix to pass to
+    // Partitioner::WriteShards and Start, or an empty string if the directory could not be created
+    // the directory and everything in it is removed by Stop
+    std::string CreateWorkDirectory();
+
+    // method to start the workers for the files written by Partitioner::WriteShards and build the overlay
+    // arcMasks[mode] has bit n set if arcs of TransportMode n are valid for mode
+    bool Start(const std::string& prefix, int shardCount, const unsigned int* arcMasks, int modeCount);
+
+    // method to stop all workers, forget the overlay and remove the work directory
+    void Stop();
+
+    // method to find the route with the fewest hops between two places
+    // route is filled with references from start to end, returns false if there is no route
+    // if a worker fails every worker is stopped, so IsRunning is false afterwards
+    bool FindShortestRoute(int mode, int startRef, int endRef, std::vector<int>& route);
+
+    // getters
+    bool IsRunning() const { return !m_workers.empty(); }
+    int GetShardCount() const { return static_cast<int>(m_workers.size()); }
+    int GetShardNodeCount(int shard) const { return m_workers[shard].nodeCount; }
+    int GetShardBoundaryCount(int shard) const { return static_cast<int>(m_workers[shard].boundary.size()); }
+    int GetCutLinkCount() const { return m_cutLinkCount; }
+
+private:
+    // worker process and the coordinator end of the socket used to talk to it
+    // -1 marks a worker that was never started, so Stop can run at any point in Start
+    struct WorkerProcess {
+        int pid = -1;
+        int fd = -1;
+        int nodeCount = 0;
+        std::vector<int> boundary;
+    };
+
+    // overlay arc, shard is -1 for a link between shards
+    struct OverlayArc {
+        int to;
+        int hops;
+        int shard;
+    };
+
+    bool LoadShardPlaces(const std::string& fileName, int shard);
+    bool BuildOverlay(const std::string& cutFileName, const unsigned int* arcMasks, int modeCount);
+    bool SendRequest(int shard, int operation, int mode, int a, int b);
+    bool ReadResponse(int shard, std::vector<int>& data);
+    bool RequestRoute(int shard, int mode, int startRef, int endRef, std::vector<int>& route);
+
+    std::vector<WorkerProcess> m_workers;
+    std::unordered_map<int, int> m_shardOf;
+    std::unordered_map<int, int> m_overlayIndex;
+    std::vector<int> m_overlayRefs;
+    // m_overlay[mode][overlay node] lists the arcs leaving that boundary place
+    std::vector<std::vector<std::vector<OverlayArc>>> m_overlay;
+    int m_cutLinkCount;
+    std::string m_workDirectory;
+};
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "ShardWorker.h"
+
+// constructor to store which arc modes each query mode may use
+ShardWorker::ShardWorker(const unsigned int* arcMasks, int modeCount)
+    : m_arcMasks(arcMasks, arcMasks + modeCount),
+    m_references(),
+    m_boundary(),
+    m_localIndex(),
+    m_modeGraphs(modeCount),
+    m_hops(),
+    m_previous(),
+    m_queue()
+{
+}
+
+// method to load the places and links files of the shard
+// it then builds one compact graph per mode from the links that mode may use
+bool ShardWorker::Load(const std::string& fileNamePlaces, const std::string& fileNameLinks) {
+    std::ifstream finPlaces(fileNamePlaces);
+    std::ifstream finLinks(fileNameLinks);
+
+    if (finPlaces.fail() || finLinks.fail()) {
+        return false;
+    }
+
+    std::string line;
+
+    // places file, only the reference and boundary flag are needed for searching
+    while (std::getline(finPlaces, line)) {
+        std::string name;
+        int reference;
+        double x, y;
+        int boundary;
+        std::istringstream iss(line);
+        std::getline(iss, name, ',');
+        iss >> reference;
+        iss.ignore();
+        iss >> x;
+        iss.ignore();
+        iss >> y;
+        iss.ignore();
+        iss >> boundary;
+
+        const int index = static_cast<int>(m_references.size());
+        m_localIndex[reference] = index;
+        m_references.push_back(reference);
+        if (boundary != 0) {
+            m_boundary.push_back(index);
+        }
+    }
+
+    // links file, every link is stored in both directions
+    std::vector<std::vector<std::pair<int, int>>> adjacency(m_references.size());
+    while (std::getline(finLinks, line)) {
+        int startRef, endRef, mode;
+        std::istringstream iss(line);
+        iss >> startRef;
+        iss.ignore();
+        iss >> endRef;
+        iss.ignore();
+        iss >> mode;
+
+        const auto startIter = m_localIndex.find(startRef);
+        const auto endIter = m_localIndex.find(endRef);
+        if (startIter != m_localIndex.end() && endIter != m_localIndex.end()) {
+            adjacency[startIter->second].emplace_back(endIter->second, mode);
+            adjacency[endIter->second].emplace_back(startIter->second, mode);
+        }
+    }
+
+    for (size_t mode = 0; mode < m_modeGraphs.size(); ++mode) {
+        ModeGraph& graph = m_modeGraphs[mode];
+        graph.offsets.assign(1, 0);
+        graph.targets.clear();
+        for (const auto& arcs : adjacency) {
+            for (const auto& arc : arcs) {
+                if ((m_arcMasks[mode] >> arc.second) & 1u) {
+                    graph.targets.push_back(arc.first);
+                }
+            }
+            graph.offsets.push_back(static_cast<int>(graph.targets.size()));
+        }
+    }
+
+    m_hops.assign(m_references.size(), -1);
+    m_previous.assign(m_references.size(), -1);
+    m_queue.reserve(m_references.size());
+
+    return true;
+}
+
+// method to run a BFS from a local node index, it stops early once stopAt is reached
+void ShardWorker::Search(int mode, int source, int stopAt) {
+    const ModeGraph& graph = m_modeGraphs[mode];
+
+    // only the nodes reached by the previous search need resetting
+    for (const int node : m_queue) {
+        m_hops[node] = -1;
+    }
+    m_queue.clear();
+
+    m_hops[source] = 0;
+    m_previous[source] = -1;
+    m_queue.push_back(source);
+
+    for (size_t head = 0; head < m_queue.size(); ++head) {
+        const int current = m_queue[head];
+        if (current == stopAt) {
+            return;
+        }
+        for (const int* it = graph.NeighboursBegin(current); it != graph.NeighboursEnd(current); ++it) {
+            if (m_hops[*it] < 0) {
+                m_hops[*it] = m_hops[current] + 1;
+                m_previous[*it] = current;
+                m_queue.push_back(*it);
+            }
+        }
+    }
+}
+
+// method to find the hops from a place to every boundary place it reaches inside the shard
+void ShardWorker::FindBoundaryHops(int mode, int sourceRef, std::vector<std::pair<int, int>>& result) {
+    result.clear();
+
+    const auto iter = m_localIndex.find(sourceRef);
+    if (iter == m_localIndex.end() || mode < 0 || mode >= GetModeCount()) {
+        return;
+    }
+
+    Search(mode, iter->second, -1);
+    for (const int node : m_boundary) {
+        if (m_hops[node] >= 0) {
+            result.emplace_back(m_references[node], m_hops[node]);
+        }
+    }
+}
+
+// method to find the route with the fewest hops between two places inside the shard
+void ShardWorker::FindShortestRoute(int mode, int startRef, int endRef, std::vector<int>& route) {
+    route.clear();
+
+    const auto startIter = m_localIndex.find(startRef);
+    const auto endIter = m_localIndex.find(endRef);
+    if (startIter == m_localIndex.end() || endIter == m_localIndex.end() || mode < 0 || mode >= GetModeCount()) {
+        return;
+    }
+
+    Search(mode, startIter->second, endIter->second);
+    if (m_hops[endIter->second] < 0) {
+        return;
+    }
+
+    for (int node = endIter->second; node != -1; node = m_previous[node]) {
+        route.push_back(m_references[node]);
+    }
+    std::reverse(route.begin(), route.end());
+}
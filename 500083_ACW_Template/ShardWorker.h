@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ModeGraph.h"
+
+// shard worker class
+// holds one shard written by the Partitioner and answers hop searches that stay inside it
+// it knows nothing about the rest of the network, so it can run in its own process
+class ShardWorker final {
+public:
+    // modeCount graphs are built, arcMasks[mode] has bit n set if arcs of TransportMode n are valid for mode
+    ShardWorker(const unsigned int* arcMasks, int modeCount);
+
+    // method to load the places and links files of the shard
+    bool Load(const std::string& fileNamePlaces, const std::string& fileNameLinks);
+
+    // method to find the hops from a place to every boundary place it reaches inside the shard
+    // result is filled with (boundary reference, hops) pairs
+    void FindBoundaryHops(int mode, int sourceRef, std::vector<std::pair<int, int>>& result);
+
+    // method to find the route with the fewest hops between two places inside the shard
+    // route is filled with references from start to end, it is left empty if there is no route
+    void FindShortestRoute(int mode, int startRef, int endRef, std::vector<int>& route);
+
+    // getters
+    int GetNodeCount() const { return static_cast<int>(m_references.size()); }
+    int GetBoundaryCount() const { return static_cast<int>(m_boundary.size()); }
+    int GetModeCount() const { return static_cast<int>(m_modeGraphs.size()); }
+
+private:
+    // method to run a BFS from a local node index, filling m_hops and m_previous
+    void Search(int mode, int source, int stopAt);
+
+    std::vector<unsigned int> m_arcMasks;
+    std::vector<int> m_references;
+    std::vector<int> m_boundary;
+    std::unordered_map<int, int> m_localIndex;
+    std::vector<ModeGraph> m_modeGraphs;
+
+    // search scratch space
+    std::vector<int> m_hops;
+    std::vector<int> m_previous;
+    std::vector<int> m_queue;
+};